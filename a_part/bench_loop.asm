@@ -0,0 +1,9 @@
+MOVC R1,#10000000
+MOVC R2,#0
+MOVC R3,#0
+ADD R2,R2,R1
+STORE R2,R3,#0
+LOAD R4,R3,#0
+SUBL R1,R1,#1
+BNZ #-16
+HALT
@@ -0,0 +1,50 @@
+MOVC R0,#0
+MOVC R1,#7
+MOVC R2,#3
+MOVC R3,#40
+DIV R4,R1,R2
+ADD R4,R4,R1
+DIV R5,R1,R0
+MUL R5,R1,R2
+MOVC R5,#1
+ADD R6,R5,R5
+STORE R6,R3,#0
+LOAD R7,R3,#0
+ADD R7,R7,R1
+STI R7,R3,#4
+STI R4,R3,#4
+LDI R8,R3,#-4
+LDI R3,R3,#-12
+ADD R9,R3,R8
+LOAD R10,R0,#44
+MOVC R10,#5
+NOP
+ADD R11,R10,R10
+NOP
+LOAD R10,R0,#44
+MOVC R10,#6
+NOP
+ADD R11,R11,R10
+MOVC R12,#6
+LOAD R12,R0,#44
+NOP
+ADD R13,R12,R12
+MOVC R14,#1
+MOVC R14,#2
+MUL R14,R14,R14
+MUL R14,R14,R2
+MUL R14,R2,R2
+MUL R14,R14,R14
+MOVC R15,#3
+SUBL R15,R15,#1
+ADD R0,R0,R15
+BNZ #-8
+SUBL R2,R2,#3
+BZ #8
+MOVC R2,#99
+MOVC R1,#4180
+JUMP R1,#8
+MOVC R2,#98
+MOVC R2,#97
+STORE R2,R0,#60
+HALT
@@ -0,0 +1,11 @@
+MOVC R1,#0
+ADDL R1,R1,#1
+ADDL R1,R1,#1
+ADDL R1,R1,#1
+ADDL R1,R1,#1
+LOAD R2,R1,#0
+ADD R3,R2,R1
+LOAD R4,R3,#0
+ADD R5,R4,R4
+MUL R6,R5,R5
+HALT
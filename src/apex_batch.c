@@ -0,0 +1,489 @@
+/*
+ * apex_batch.c
+ * Contains the batch driver which runs many simulations in parallel
+ *
+ * A manifest lists one job per line: "<input_file> <simulate/functional>
+ * <no of cycles>". Blank lines and lines starting with '#' are skipped. Jobs
+ * run on a pool of worker threads, one APEX_CPU per job. Each worker owns a
+ * contiguous range of jobs, runs them from the front and, once it runs dry,
+ * steals the back half of the fullest remaining range. Results are written
+ * as one JSON object per line, in manifest order.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+typedef struct APEX_Batch_Job
+{
+    char *filename;
+    char mode[16];
+    long long cycles;
+    APEX_Options options;
+    char *result;  /* Formatted JSON result */
+    int failed;
+} APEX_Batch_Job;
+
+/* Range of job indices [head, tail) owned by a worker */
+typedef struct APEX_Batch_Queue
+{
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+} APEX_Batch_Queue;
+
+typedef struct APEX_Batch
+{
+    APEX_Batch_Job *jobs;
+    int num_jobs;
+    APEX_Batch_Queue *queues;
+    int num_workers;
+} APEX_Batch;
+
+typedef struct APEX_Batch_Worker
+{
+    APEX_Batch *batch;
+    int id;
+} APEX_Batch_Worker;
+
+/* Writes a string as a JSON string literal */
+static void
+print_json_string(FILE *fp, const char *str)
+{
+    fputc('"', fp);
+    for (; *str; ++str)
+    {
+        if (*str == '"' || *str == '\\')
+        {
+            fputc('\\', fp);
+            fputc(*str, fp);
+        }
+        else if ((unsigned char)*str < 0x20)
+        {
+            fprintf(fp, "\\u%04x", *str);
+        }
+        else
+        {
+            fputc(*str, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+/* Formats the final architectural state of a finished job */
+static void
+print_job_result(FILE *fp, int index, const APEX_Batch_Job *job,
+                 const APEX_CPU *cpu)
+{
+    int i, first = TRUE;
+
+    fprintf(fp, "{\"job\":%d,\"input_file\":", index);
+    print_json_string(fp, job->filename);
+    fprintf(fp, ",\"mode\":\"%s\",\"status\":\"%s\"", job->mode,
+            !cpu ? "error" : cpu->fault ? "fault" : "ok");
+    if (!cpu)
+    {
+        fprintf(fp, "}");
+        return;
+    }
+
+    fprintf(fp, ",\"cycles\":%lld,\"instructions\":%lld,\"pc\":%d",
+            cpu->clock, cpu->insn_completed, cpu->pc);
+    fprintf(fp, ",\"zero_flag\":%d,\"pos_flag\":%d,\"regs\":[", cpu->zero_flag,
+            cpu->pos_flag);
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        fprintf(fp, "%s%d", i ? "," : "", cpu->regs[i]);
+    }
+
+    /* Data memory is sparse, only non-zero words of written pages are
+     * listed */
+    fprintf(fp, "],\"data_memory\":{");
+    for (i = 0; i < cpu->data_memory.num_pages; ++i)
+    {
+        const APEX_Page *page = cpu->data_memory.pages[i];
+        int j;
+
+        for (j = 0; page && j < APEX_PAGE_WORDS; ++j)
+        {
+            if (page->words[j])
+            {
+                fprintf(fp, "%s\"%d\":%d", first ? "" : ",",
+                        (i << APEX_PAGE_SHIFT) + j, page->words[j]);
+                first = FALSE;
+            }
+        }
+    }
+    fprintf(fp, "}");
+
+    if (!cpu->functional)
+    {
+        fprintf(fp, ",\"forwarding\":\"%s\",\"stats\":",
+                APEX_forwarding_name(cpu->forwarding));
+        APEX_stats_print(fp, cpu);
+    }
+    fprintf(fp, "}");
+}
+
+static void
+run_job(int index, APEX_Batch_Job *job)
+{
+    APEX_CPU *cpu;
+    size_t len;
+    FILE *fp;
+
+    cpu = APEX_cpu_init(job->filename, job->mode, job->cycles,
+                        job->options.data_memory_size);
+    if (cpu)
+    {
+        cpu->quiet = TRUE;
+        if (APEX_cpu_set_options(cpu, &job->options))
+        {
+            APEX_cpu_stop(cpu);
+            cpu = NULL;
+        }
+    }
+
+    job->failed = !cpu;
+    if (cpu)
+    {
+        if (cpu->functional)
+        {
+            APEX_functional_run(cpu);
+        }
+        else
+        {
+            APEX_cpu_run(cpu);
+        }
+    }
+
+    fp = open_memstream(&job->result, &len);
+    if (fp)
+    {
+        print_job_result(fp, index, job, cpu);
+        fclose(fp);
+    }
+
+    if (cpu)
+    {
+        APEX_cpu_stop(cpu);
+    }
+}
+
+/* Takes the next job from the front of a worker's own range, -1 if empty */
+static int
+pop_job(APEX_Batch_Queue *queue)
+{
+    int index = -1;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail)
+    {
+        index = queue->head++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+/*
+ * Moves the back half of the largest other range into the worker's own
+ * (empty) range. Returns FALSE once there is nothing left to steal.
+ */
+static int
+steal_jobs(APEX_Batch *batch, int id)
+{
+    APEX_Batch_Queue *own = &batch->queues[id];
+    int i, victim = -1, remaining = 0;
+    int head, tail;
+
+    for (i = 1; i < batch->num_workers; ++i)
+    {
+        int other = (id + i) % batch->num_workers;
+        int size;
+
+        pthread_mutex_lock(&batch->queues[other].lock);
+        size = batch->queues[other].tail - batch->queues[other].head;
+        pthread_mutex_unlock(&batch->queues[other].lock);
+
+        /* The range may shrink before it is locked again below */
+        if (size > remaining)
+        {
+            remaining = size;
+            victim = other;
+        }
+    }
+
+    if (victim < 0)
+    {
+        return FALSE;
+    }
+
+    pthread_mutex_lock(&batch->queues[victim].lock);
+    head = batch->queues[victim].head;
+    tail = batch->queues[victim].tail;
+    if (head < tail)
+    {
+        /* Leave the victim the front half, it is working on its head */
+        head += (tail - head) / 2;
+        batch->queues[victim].tail = head;
+    }
+    pthread_mutex_unlock(&batch->queues[victim].lock);
+
+    pthread_mutex_lock(&own->lock);
+    own->head = head;
+    own->tail = tail;
+    pthread_mutex_unlock(&own->lock);
+    return TRUE;
+}
+
+static void *
+worker_main(void *arg)
+{
+    APEX_Batch_Worker *worker = arg;
+    APEX_Batch *batch = worker->batch;
+    int index;
+
+    do
+    {
+        while ((index = pop_job(&batch->queues[worker->id])) >= 0)
+        {
+            run_job(index, &batch->jobs[index]);
+        }
+    } while (steal_jobs(batch, worker->id));
+
+    return NULL;
+}
+
+/*
+ * Reads the manifest into batch->jobs. Returns 0 on success.
+ */
+static int
+read_manifest(APEX_Batch *batch, const char *filename)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t len = 0;
+    int capacity = 0, line_number = 0;
+    char path[4096], mode[16], option[64];
+    APEX_Batch_Job *job;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open manifest %s\n", filename);
+        return -1;
+    }
+
+    while (getline(&line, &len, fp) != -1)
+    {
+        APEX_Options job_options;
+        char count[32], *end;
+        long long cycles = 0;
+        int fields, valid, offset = 0, length;
+
+        line_number++;
+        fields = sscanf(line, "%4095s %15s %31s%n", path, mode, count, &offset);
+        if (fields <= 0 || path[0] == '#')
+        {
+            continue;
+        }
+
+        /* Any number of options follow. Results are collected in memory,
+         * jobs do not save checkpoints */
+        valid = fields >= 3;
+        if (valid)
+        {
+            errno = 0;
+            cycles = strtoll(count, &end, 10);
+            valid = end != count && !*end && errno != ERANGE;
+        }
+        APEX_options_init(&job_options);
+        while (valid && sscanf(line + offset, " %63s%n", option, &length) == 1)
+        {
+            valid = APEX_parse_option(option, &job_options) == 0
+                    && !job_options.checkpoint;
+            offset += length;
+        }
+
+        if (!valid
+            || (strcmp(mode, "simulate") != 0
+                && strcmp(mode, "functional") != 0))
+        {
+            fprintf(stderr,
+                    "APEX_Error: Invalid job on line %d of %s, expected "
+                    "<input_file> <simulate/functional> <no of cycles> "
+                    "[<none/ex/full>] [mem=<words>] "
+                    "[alu=/mul=/div=/agu=<latency>[p]] "
+                    "[bp=<predictor>] [bht=<counters>] [btb=<entries>] "
+                    "[width=<instructions>] [core=<back end>] "
+                    "[rob=/iq=/lsq=<entries>] [prf=<registers>] "
+                    "[l1i=/l1d=/l2=<bytes>:<ways>:<line>[:<policy>]] "
+                    "[l2lat=/dram=<cycles>] [fetchblock=<bytes>] "
+                    "[iprefetch=/dprefetch=<prefetcher>] "
+                    "[pfentries=<entries>] [pfdegree=<lines>] "
+                    "[sb=<entries>] [sbdrain=<cycles>]\n",
+                    line_number, filename);
+            free(line);
+            fclose(fp);
+            return -1;
+        }
+
+        if (batch->num_jobs == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            job = realloc(batch->jobs, capacity * sizeof(APEX_Batch_Job));
+            if (!job)
+            {
+                free(line);
+                fclose(fp);
+                return -1;
+            }
+            batch->jobs = job;
+        }
+
+        job = &batch->jobs[batch->num_jobs++];
+        memset(job, 0, sizeof(*job));
+        job->filename = strdup(path);
+        strcpy(job->mode, mode);
+        job->cycles = cycles;
+        job->options = job_options;
+    }
+
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+/* Frees the jobs of a batch and their results */
+static void
+free_jobs(APEX_Batch *batch)
+{
+    int i;
+
+    for (i = 0; i < batch->num_jobs; ++i)
+    {
+        free(batch->jobs[i].result);
+        free(batch->jobs[i].filename);
+    }
+    free(batch->jobs);
+}
+
+/*
+ * Runs every job of a manifest on num_workers threads (all online cores if
+ * not positive) and writes the results to results_file, or stdout if NULL.
+ * The jobs of a worker which cannot be started are stolen by the others.
+ * Returns 0 if every job ran.
+ */
+int
+APEX_batch_run(const char *manifest, int num_workers, const char *results_file)
+{
+    APEX_Batch batch;
+    APEX_Batch_Worker *workers;
+    pthread_t *threads;
+    FILE *out = stdout;
+    int i, failed = 0, started = 0;
+
+    memset(&batch, 0, sizeof(batch));
+    if (read_manifest(&batch, manifest))
+    {
+        free_jobs(&batch);
+        return -1;
+    }
+
+    /* Before the sweep, which a bad path would otherwise waste */
+    if (results_file)
+    {
+        out = fopen(results_file, "w");
+        if (!out)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create %s\n", results_file);
+            free_jobs(&batch);
+            return -1;
+        }
+    }
+
+    if (num_workers <= 0)
+    {
+        num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (num_workers > batch.num_jobs)
+    {
+        num_workers = batch.num_jobs > 0 ? batch.num_jobs : 1;
+    }
+    batch.num_workers = num_workers;
+
+    batch.queues = calloc(num_workers, sizeof(APEX_Batch_Queue));
+    workers = calloc(num_workers, sizeof(APEX_Batch_Worker));
+    threads = calloc(num_workers, sizeof(pthread_t));
+    if (!batch.queues || !workers || !threads)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate %d workers\n",
+                num_workers);
+        free(batch.queues);
+        free(workers);
+        free(threads);
+        free_jobs(&batch);
+        if (out != stdout)
+        {
+            fclose(out);
+        }
+        return -1;
+    }
+
+    /* Start every worker with an equal contiguous share of the jobs */
+    for (i = 0; i < num_workers; ++i)
+    {
+        pthread_mutex_init(&batch.queues[i].lock, NULL);
+        batch.queues[i].head = (long)batch.num_jobs * i / num_workers;
+        batch.queues[i].tail = (long)batch.num_jobs * (i + 1) / num_workers;
+        workers[i].batch = &batch;
+        workers[i].id = i;
+    }
+
+    while (started < num_workers
+           && pthread_create(&threads[started], NULL, worker_main,
+                             &workers[started]) == 0)
+    {
+        started++;
+    }
+    if (!started)
+    {
+        worker_main(&workers[0]);
+    }
+    for (i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    for (i = 0; i < num_workers; ++i)
+    {
+        pthread_mutex_destroy(&batch.queues[i].lock);
+    }
+
+    for (i = 0; i < batch.num_jobs; ++i)
+    {
+        if (batch.jobs[i].result)
+        {
+            fprintf(out, "%s\n", batch.jobs[i].result);
+        }
+        failed += batch.jobs[i].failed;
+    }
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    fprintf(stderr, "APEX_Batch: %d jobs on %d workers, %d failed\n",
+            batch.num_jobs, started ? started : 1, failed);
+
+    free(threads);
+    free(workers);
+    free(batch.queues);
+    free_jobs(&batch);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * apex_bench.c
+ * Microbenchmarks for the APEX simulator, run with "make bench"
+ *
+ * Results are reported on stderr, simulator output goes to stdout as usual.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "apex_cpu.h"
+
+static double
+get_time_in_seconds()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Runs the pipeline for at most n cycles in the given mode (simulate, display
+ * or trace, writing a binary trace to trace_file) and reports simulated
+ * cycles per second of host time
+ */
+static int
+bench_cycles(const char *filename, long long n, const char *mode,
+             const char *trace_file)
+{
+    APEX_CPU *cpu;
+    double start, elapsed;
+
+    cpu = APEX_cpu_init(filename, mode, n, DATA_MEMORY_SIZE);
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        return 1;
+    }
+
+    if (trace_file)
+    {
+        cpu->trace = APEX_trace_open(trace_file, APEX_TRACE_BINARY, cpu->width,
+                                     cpu->code_memory, cpu->code_memory_size);
+        if (!cpu->trace)
+        {
+            APEX_cpu_stop(cpu);
+            return 1;
+        }
+    }
+
+    /* Includes writing out the trace, which is flushed when the run ends */
+    start = get_time_in_seconds();
+    APEX_cpu_run(cpu);
+    elapsed = get_time_in_seconds() - start;
+
+    fprintf(stderr,
+            "APEX_Bench: cycles (%s): %lld cycles, %lld instructions in "
+            "%.3f s, %.0f cycles/s\n",
+            mode, cpu->clock, cpu->insn_completed, elapsed,
+            cpu->clock / elapsed);
+
+    APEX_cpu_stop(cpu);
+    return 0;
+}
+
+/*
+ * Writes a synthetic program of the given number of lines using every
+ * instruction format, for the parser benchmark
+ */
+static int
+bench_generate(const char *filename, int lines)
+{
+    FILE *fp;
+    int i, a, b, c;
+
+    fp = fopen(filename, "w");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create %s\n", filename);
+        return 1;
+    }
+
+    for (i = 0; i < lines; ++i)
+    {
+        a = i % REG_FILE_SIZE;
+        b = (i / 3) % REG_FILE_SIZE;
+        c = (i / 7) % REG_FILE_SIZE;
+
+        switch (i % 12)
+        {
+            case 0: fprintf(fp, "ADD R%d,R%d,R%d\n", a, b, c); break;
+            case 1: fprintf(fp, "SUBL R%d,R%d,#%d\n", a, b, i % 1000); break;
+            case 2: fprintf(fp, "MOVC R%d,#%d\n", a, i); break;
+            case 3: fprintf(fp, "LOAD R%d,R%d,#%d\n", a, b, i % 64); break;
+            case 4: fprintf(fp, "STORE R%d,R%d,#%d\n", a, b, i % 64); break;
+            case 5: fprintf(fp, "EXOR R%d,R%d,R%d\n", a, b, c); break;
+            case 6: fprintf(fp, "CMP R%d,R%d\n", a, b); break;
+            case 7: fprintf(fp, "BNZ #%d\n", 4 * (i % 8) - 16); break;
+            case 8: fprintf(fp, "LDI R%d,R%d,#%d\n", a, b, i % 64); break;
+            case 9: fprintf(fp, "STI R%d,R%d,#%d\n", a, b, i % 64); break;
+            case 10: fprintf(fp, "JUMP R%d,#%d\n", a, i % 100); break;
+            default: fprintf(fp, "NOP\n"); break;
+        }
+    }
+    fprintf(fp, "HALT\n");
+
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * Parses a program into code memory and reports lines/second
+ */
+static int
+bench_parse(const char *filename)
+{
+    APEX_Instruction *code_memory;
+    int size = 0;
+    double start, elapsed;
+    FILE *fp;
+    long bytes;
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open %s\n", filename);
+        return 1;
+    }
+    fseek(fp, 0, SEEK_END);
+    bytes = ftell(fp);
+    fclose(fp);
+
+    start = get_time_in_seconds();
+    code_memory = create_code_memory(filename, &size);
+    elapsed = get_time_in_seconds() - start;
+
+    if (!code_memory)
+    {
+        fprintf(stderr, "APEX_Error: Unable to parse %s\n", filename);
+        return 1;
+    }
+
+    fprintf(stderr,
+            "APEX_Bench: parse: %d lines, %.1f MB in %.3f s, %.0f lines/s\n",
+            size, bytes / 1e6, elapsed, size / elapsed);
+
+    free(code_memory);
+    return 0;
+}
+
+/*
+ * Reports startup latency: the time APEX_cpu_init takes to load a program
+ */
+static int
+bench_startup(const char *filename)
+{
+    APEX_CPU *cpu;
+    double start, elapsed;
+
+    start = get_time_in_seconds();
+    cpu = APEX_cpu_init(filename, "simulate", 0, DATA_MEMORY_SIZE);
+    elapsed = get_time_in_seconds() - start;
+
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        return 1;
+    }
+
+    fprintf(stderr, "APEX_Bench: startup: %d instructions in %.1f ms\n",
+            cpu->code_memory_size, elapsed * 1e3);
+
+    APEX_cpu_stop(cpu);
+    return 0;
+}
+
+int
+main(int argc, char const *argv[])
+{
+    if (argc >= 4 && argc <= 6 && strcmp(argv[1], "cycles") == 0)
+    {
+        return bench_cycles(argv[2], atoll(argv[3]),
+                            argc >= 5 ? argv[4] : "simulate",
+                            argc == 6 ? argv[5] : NULL);
+    }
+
+    if (argc == 4 && strcmp(argv[1], "gen") == 0)
+    {
+        return bench_generate(argv[2], atoi(argv[3]));
+    }
+
+    if (argc == 3 && strcmp(argv[1], "parse") == 0)
+    {
+        return bench_parse(argv[2]);
+    }
+
+    if (argc == 3 && strcmp(argv[1], "startup") == 0)
+    {
+        return bench_startup(argv[2]);
+    }
+
+    fprintf(stderr,
+            "APEX_Help: Usage %s cycles <input_file> <no of cycles> "
+            "[<mode> [<trace_file>]]\n"
+            "                 %s gen <output_file> <no of lines>\n"
+            "                 %s parse <input_file>\n"
+            "                 %s startup <input_file>\n",
+            argv[0], argv[0], argv[0], argv[0]);
+    return 1;
+}
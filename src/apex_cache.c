@@ -0,0 +1,402 @@
+/*
+ * apex_cache.c
+ * Contains the configuration, misses and prefetches of the caches, see
+ * apex_cache.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cache.h"
+
+static const char *const policy_names[] = {
+    [APEX_CACHE_LRU] = "lru",
+    [APEX_CACHE_FIFO] = "fifo",
+    [APEX_CACHE_RANDOM] = "random",
+};
+
+/* Returns TRUE if n is a power of 2 in min to max */
+static int
+valid_power(int n, int min, int max)
+{
+    return n >= min && n <= max && (n & (n - 1)) == 0;
+}
+
+/* Returns TRUE if a cache of config has a power of 2 of sets and fits */
+static int
+valid_config(const APEX_Cache_Config *config)
+{
+    const int set_size = config->ways * config->line;
+
+    return valid_power(config->ways, 1, APEX_CACHE_MAX_WAYS)
+           && valid_power(config->line, APEX_CACHE_MIN_LINE,
+                          APEX_CACHE_MAX_LINE)
+           && config->size > 0 && config->size % set_size == 0
+           && valid_power(config->size / set_size, 1, APEX_CACHE_MAX_LINES)
+           && config->size / config->line <= APEX_CACHE_MAX_LINES
+           && config->policy >= APEX_CACHE_LRU
+           && config->policy <= APEX_CACHE_RANDOM;
+}
+
+/*
+ * Allocates the lines of a cache given its geometry, over arrays it does not
+ * own, every way invalid. Returns 0 on success.
+ */
+int
+APEX_cache_alloc(APEX_Cache *cache)
+{
+    const int lines = APEX_cache_lines(cache);
+
+    cache->tags = NULL;
+    cache->stamps = NULL;
+    cache->dirty = NULL;
+    cache->prefetched = NULL;
+    if (!lines)
+    {
+        return 0;
+    }
+
+    cache->tags = malloc(lines * sizeof(int));
+    cache->stamps = calloc(lines, sizeof(unsigned int));
+    cache->dirty = calloc(lines, sizeof(unsigned char));
+    cache->prefetched = calloc(lines, sizeof(long long));
+    if (!cache->tags || !cache->stamps || !cache->dirty || !cache->prefetched)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate a cache of %d "
+                        "lines\n", lines);
+        APEX_cache_free(cache);
+        return -1;
+    }
+    memset(cache->tags, 0xff, lines * sizeof(int));
+    return 0;
+}
+
+void
+APEX_cache_free(APEX_Cache *cache)
+{
+    free(cache->tags);
+    free(cache->stamps);
+    free(cache->dirty);
+    free(cache->prefetched);
+    cache->tags = NULL;
+    cache->stamps = NULL;
+    cache->dirty = NULL;
+    cache->prefetched = NULL;
+}
+
+/*
+ * Makes dst, a cache owning its lines or zeroed, a copy of src with lines of
+ * its own, reusing those of dst if it has as many. Returns 0 on success.
+ */
+int
+APEX_cache_copy(APEX_Cache *dst, const APEX_Cache *src)
+{
+    const int lines = APEX_cache_lines(src);
+    APEX_Cache copy = *src;
+
+    if (lines == APEX_cache_lines(dst))
+    {
+        copy.tags = dst->tags;
+        copy.stamps = dst->stamps;
+        copy.dirty = dst->dirty;
+        copy.prefetched = dst->prefetched;
+    }
+    else if (APEX_cache_alloc(&copy))
+    {
+        return -1;
+    }
+    else
+    {
+        APEX_cache_free(dst);
+    }
+
+    if (lines)
+    {
+        memcpy(copy.tags, src->tags, lines * sizeof(int));
+        memcpy(copy.stamps, src->stamps, lines * sizeof(unsigned int));
+        memcpy(copy.dirty, src->dirty, lines * sizeof(unsigned char));
+        memcpy(copy.prefetched, src->prefetched, lines * sizeof(long long));
+    }
+    *dst = copy;
+    return 0;
+}
+
+/*
+ * Sets up an empty cache of config over one owning its lines or zeroed,
+ * taking latency cycles when accessed after a miss in the level above, or no
+ * cache if config has no size. Returns 0 on success.
+ */
+int
+APEX_cache_init(APEX_Cache *cache, const APEX_Cache_Config *config,
+                int latency)
+{
+    APEX_Cache init;
+
+    if ((config->size && !valid_config(config)) || latency < 1
+        || latency > APEX_CACHE_MAX_LATENCY)
+    {
+        fprintf(stderr, "APEX_Error: Caches take a power of 2 of up to %d "
+                        "ways, of %d to %d byte lines and of sets, at most "
+                        "%d lines and latencies up to %d cycles\n",
+                APEX_CACHE_MAX_WAYS, APEX_CACHE_MIN_LINE, APEX_CACHE_MAX_LINE,
+                APEX_CACHE_MAX_LINES, APEX_CACHE_MAX_LATENCY);
+        return -1;
+    }
+
+    memset(&init, 0, sizeof(APEX_Cache));
+    init.config = *config;
+    init.latency = latency;
+    if (config->size)
+    {
+        init.sets = config->size / (config->ways * config->line);
+        init.line_shift = __builtin_ctz(config->line / 4);
+        init.way_shift = __builtin_ctz(config->ways);
+        init.random = 1;
+    }
+    if (APEX_cache_alloc(&init))
+    {
+        return -1;
+    }
+
+    APEX_cache_free(cache);
+    *cache = init;
+    return 0;
+}
+
+/* Returns TRUE if a loaded cache is absent or has a valid geometry */
+int
+APEX_cache_valid(const APEX_Cache *cache)
+{
+    const APEX_Cache_Config *config = &cache->config;
+
+    if (cache->latency < 1 || cache->latency > APEX_CACHE_MAX_LATENCY)
+    {
+        return FALSE;
+    }
+    if (!config->size)
+    {
+        return TRUE;
+    }
+    return valid_config(config)
+           && cache->sets == config->size / (config->ways * config->line)
+           && cache->line_shift == __builtin_ctz(config->line / 4)
+           && cache->way_shift == __builtin_ctz(config->ways);
+}
+
+/*
+ * Returns the replacement policy named lru, fifo or random, or -1
+ */
+int
+APEX_cache_policy(const char *name)
+{
+    int policy;
+
+    for (policy = APEX_CACHE_LRU; policy <= APEX_CACHE_RANDOM; ++policy)
+    {
+        if (strcmp(name, policy_names[policy]) == 0)
+        {
+            return policy;
+        }
+    }
+    return -1;
+}
+
+const char *
+APEX_cache_policy_name(int policy)
+{
+    return policy_names[policy];
+}
+
+/* Returns the index of the first way of the set holding line */
+static int
+set_base(const APEX_Cache *cache, int line)
+{
+    return (line & (cache->sets - 1)) << cache->way_shift;
+}
+
+/* Returns the way of the set at base to fill, an invalid one first */
+static int
+victim(APEX_Cache *cache, int base)
+{
+    int i, index = APEX_cache_find(cache, base, APEX_CACHE_INVALID);
+    unsigned int age, oldest = 0;
+
+    if (index >= 0)
+    {
+        return index;
+    }
+
+    if (cache->config.policy == APEX_CACHE_RANDOM)
+    {
+        cache->random ^= cache->random << 13;
+        cache->random ^= cache->random >> 17;
+        cache->random ^= cache->random << 5;
+        return base + (int)(cache->random & (cache->config.ways - 1));
+    }
+
+    /* Ages count from the stamps, so the tick may wrap around */
+    index = base;
+    for (i = base; i < base + cache->config.ways; ++i)
+    {
+        age = cache->tick - cache->stamps[i];
+        if (age > oldest)
+        {
+            oldest = age;
+            index = i;
+        }
+    }
+    return index;
+}
+
+/*
+ * Fills line into its set, dirty if written. Returns the way it took and sets
+ * evicted to the line address of the dirty line it evicted, or
+ * APEX_CACHE_INVALID.
+ */
+static int
+fill(APEX_Cache *cache, int line, int dirty, int *evicted)
+{
+    const int index = victim(cache, set_base(cache, line));
+
+    *evicted = APEX_CACHE_INVALID;
+    if (cache->tags[index] != APEX_CACHE_INVALID && cache->dirty[index])
+    {
+        *evicted = cache->tags[index];
+        cache->writebacks++;
+    }
+    cache->tags[index] = line;
+    cache->dirty[index] = dirty;
+    cache->prefetched[index] = 0;
+    cache->stamps[index] = ++cache->tick;
+    return index;
+}
+
+/*
+ * Returns the address in l2 of the line of l1 holding line. Code lines take
+ * the negative addresses below APEX_CACHE_INVALID, data lines are never
+ * negative.
+ *
+ * Note: L2 lines are at least as long as L1 lines, so an L1 line lies within
+ * a single L2 line.
+ */
+static int
+l2_line(const APEX_Cache *l1, const APEX_Cache *l2, int line)
+{
+    const int target = (line << l1->line_shift) >> l2->line_shift;
+
+    return l1->code ? APEX_CACHE_INVALID - 1 - target : target;
+}
+
+/*
+ * Fills line into l1 from l2, if there is one, filling it into l2 too if it
+ * misses there, and writes a dirty line evicted from l1 to l2. Sets way to
+ * the way of l1 filled and returns the cycles the fill takes beyond an L1
+ * hit.
+ */
+static int
+refill(APEX_Cache *l1, APEX_Cache *l2, int dram_latency, int line, int write,
+       int *way)
+{
+    int cycles = dram_latency;
+    int target, index, evicted;
+
+    if (l2->config.size)
+    {
+        target = l2_line(l1, l2, line);
+        index = APEX_cache_find(l2, set_base(l2, target), target);
+        cycles = l2->latency;
+        if (index < 0)
+        {
+            l2->misses++;
+            cycles += dram_latency;
+            fill(l2, target, FALSE, &evicted);
+        }
+        else
+        {
+            l2->hits++;
+            if (l2->config.policy == APEX_CACHE_LRU)
+            {
+                l2->stamps[index] = ++l2->tick;
+            }
+        }
+    }
+
+    *way = fill(l1, line, write, &evicted);
+    if (evicted != APEX_CACHE_INVALID && l2->config.size)
+    {
+        target = l2_line(l1, l2, evicted);
+        index = APEX_cache_find(l2, set_base(l2, target), target);
+        if (index < 0)
+        {
+            fill(l2, target, TRUE, &evicted);
+        }
+        else
+        {
+            l2->dirty[index] = TRUE;
+        }
+    }
+    return cycles;
+}
+
+/*
+ * Handles an access missing in l1 to its line, see refill. Returns the
+ * cycles the access takes beyond an L1 hit.
+ */
+int
+APEX_cache_miss(APEX_Cache *l1, APEX_Cache *l2, int dram_latency, int line,
+                int write)
+{
+    int way;
+
+    l1->misses++;
+    return refill(l1, l2, dram_latency, line, write, &way);
+}
+
+/*
+ * Prefetches line into l1 at clock, unless it holds it already. The line
+ * arrives when a miss to it would have. Returns TRUE if it was prefetched.
+ */
+int
+APEX_cache_prefetch(APEX_Cache *l1, APEX_Cache *l2, int dram_latency,
+                    int line, long long clock)
+{
+    int way, cycles;
+
+    if (APEX_cache_find(l1, set_base(l1, line), line) >= 0)
+    {
+        return FALSE;
+    }
+
+    l1->prefetches++;
+    cycles = refill(l1, l2, dram_latency, line, FALSE, &way);
+    l1->prefetched[way] = clock + cycles;
+    return TRUE;
+}
+
+/*
+ * Gives line up to another cache holding it: writes it back if it is dirty
+ * and keeps it clean, or, if invalidate is set, drops it, its data going to
+ * the other cache instead. Returns the way that held line, or -1.
+ */
+int
+APEX_cache_downgrade(APEX_Cache *cache, int line, int invalidate)
+{
+    const int index = APEX_cache_find(cache, set_base(cache, line), line);
+
+    if (index < 0)
+    {
+        return -1;
+    }
+
+    if (invalidate)
+    {
+        cache->tags[index] = APEX_CACHE_INVALID;
+        cache->prefetched[index] = 0;
+    }
+    else if (cache->dirty[index])
+    {
+        cache->writebacks++;
+    }
+    cache->dirty[index] = FALSE;
+    return index;
+}
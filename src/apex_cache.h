@@ -0,0 +1,194 @@
+/*
+ * apex_cache.h
+ * Contains the cache hierarchy of the APEX cpu
+ *
+ * Given l1d=, every load and store looks its line up in a set-associative L1
+ * data cache, and given l1i=, fetch looks up every group it fetches in an L1
+ * instruction cache. Both are backed by an optional L2, shared by code and
+ * data but keeping their lines apart, and by memory, which takes a fixed
+ * DRAM latency. The caches model timing only: they hold tags, data memory
+ * keeps the only copy of the data, so no configuration changes what a
+ * program computes. Code lines count instructions from the first one, whose
+ * address is 4000.
+ *
+ * Both levels are write-back and write-allocate. A miss fills the line into
+ * every level it missed, evicting an invalid way first, else the one chosen
+ * by the replacement policy: the least recently used, the first filled or a
+ * pseudo-random one. A dirty line evicted from L1 is written to L2 and one
+ * evicted from L2 to memory, through a write buffer that costs no cycles.
+ *
+ * A hit in L1 takes the memory or fetch stage's cycle. A miss adds the
+ * latency of L2 if it hits there, else that of L2 and DRAM, or of DRAM alone
+ * without L2. Prefetched lines arrive as late as a miss would, see
+ * apex_prefetch.h.
+ *
+ * Tags are kept apart from the replacement stamps and dirty bits, the ways
+ * of a set next to each other, so a lookup compares a whole set of tags at a
+ * time, four ways per SSE2 instruction where available. The arrays are
+ * allocated for the configured sets and ways, a level without a size has
+ * none.
+ */
+#ifndef _APEX_CACHE_H_
+#define _APEX_CACHE_H_
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "apex_macros.h"
+
+/* Replacement policies */
+#define APEX_CACHE_LRU 0
+#define APEX_CACHE_FIFO 1
+#define APEX_CACHE_RANDOM 2
+
+/* Largest level, 1 MB of 64 byte lines. Ways and line bytes are powers of 2,
+ * lines hold at least one 4 byte word */
+#define APEX_CACHE_MAX_LINES 16384
+#define APEX_CACHE_MAX_WAYS 16
+#define APEX_CACHE_MIN_LINE 4
+#define APEX_CACHE_MAX_LINE 4096
+
+/* Longest L2 or DRAM latency in cycles */
+#define APEX_CACHE_MAX_LATENCY 10000
+
+/* Default latencies */
+#define APEX_CACHE_L2_LATENCY 10
+#define APEX_CACHE_DRAM_LATENCY 100
+
+/* Tag of an invalid way, line addresses are never negative */
+#define APEX_CACHE_INVALID -1
+
+/* Geometry of a cache level, as given by an option */
+typedef struct APEX_Cache_Config
+{
+    int size;   /* Bytes, 0 for no cache */
+    int ways;
+    int line;   /* Bytes per line */
+    int policy; /* APEX_CACHE_* */
+} APEX_Cache_Config;
+
+typedef struct APEX_Cache
+{
+    APEX_Cache_Config config;
+    int latency;          /* Cycles it adds to a miss above, 1 for L1 */
+    int code;             /* Holds instructions, kept apart from data in L2 */
+    int sets;
+    int line_shift;       /* Address bits of a word within its line */
+    int way_shift;        /* Bits of the way within a set */
+    unsigned int tick;    /* Orders the stamps, counts uses and fills */
+    unsigned int random;  /* Xorshift state of random replacement */
+    long long hits;       /* Lookups, from the pipeline or L1 */
+    long long misses;
+    long long writebacks; /* Dirty lines evicted */
+    long long prefetches; /* Lines filled ahead of a demand access */
+    long long useful_prefetches; /* Prefetched lines hit by one since */
+    long long late_prefetches; /* Of them, hit before they arrived */
+    int *tags;            /* Line address held by each way, by set */
+    unsigned int *stamps; /* Tick of last use or fill */
+    unsigned char *dirty;
+    long long *prefetched; /* Clock a prefetched line arrives, 0 once hit */
+} APEX_Cache;
+
+int APEX_cache_init(APEX_Cache *cache, const APEX_Cache_Config *config,
+                    int latency);
+int APEX_cache_alloc(APEX_Cache *cache);
+void APEX_cache_free(APEX_Cache *cache);
+int APEX_cache_copy(APEX_Cache *dst, const APEX_Cache *src);
+int APEX_cache_valid(const APEX_Cache *cache);
+int APEX_cache_policy(const char *name);
+const char *APEX_cache_policy_name(int policy);
+int APEX_cache_miss(APEX_Cache *l1, APEX_Cache *l2, int dram_latency,
+                    int line, int write);
+int APEX_cache_prefetch(APEX_Cache *l1, APEX_Cache *l2, int dram_latency,
+                        int line, long long clock);
+int APEX_cache_downgrade(APEX_Cache *cache, int line, int invalidate);
+
+/* Returns the number of ways in all sets of a cache, 0 without a size */
+static inline int
+APEX_cache_lines(const APEX_Cache *cache)
+{
+    return cache->sets << cache->way_shift;
+}
+
+/*
+ * Returns the index of the way of a set, starting at index base, that holds
+ * tag, or -1
+ */
+static inline int
+APEX_cache_find(const APEX_Cache *cache, int base, int tag)
+{
+    const int ways = cache->config.ways;
+    int i;
+
+#ifdef __SSE2__
+    if (ways >= 4)
+    {
+        const __m128i key = _mm_set1_epi32(tag);
+        int mask;
+
+        for (i = 0; i < ways; i += 4)
+        {
+            mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i *)&cache->tags[base + i]),
+                key)));
+            if (mask)
+            {
+                return base + i + __builtin_ctz(mask);
+            }
+        }
+        return -1;
+    }
+#endif
+
+    for (i = base; i < base + ways; ++i)
+    {
+        if (cache->tags[i] == tag)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Accesses the word at address, an address within data memory, or the index
+ * of an instruction for an instruction cache, through L1 and L2, l2 without
+ * a size if there is none, at clock. Returns the cycles the access takes
+ * beyond an L1 hit, those until its line arrives if it was prefetched.
+ */
+static inline int
+APEX_cache_access(APEX_Cache *l1, APEX_Cache *l2, int dram_latency,
+                  int address, int write, long long clock)
+{
+    const int line = address >> l1->line_shift;
+    const int index
+        = APEX_cache_find(l1, (line & (l1->sets - 1)) << l1->way_shift, line);
+
+    if (index < 0)
+    {
+        return APEX_cache_miss(l1, l2, dram_latency, line, write);
+    }
+
+    l1->hits++;
+    l1->dirty[index] |= write;
+    if (l1->config.policy == APEX_CACHE_LRU)
+    {
+        l1->stamps[index] = ++l1->tick;
+    }
+    if (l1->prefetched[index])
+    {
+        const long long late = l1->prefetched[index] - clock;
+
+        l1->prefetched[index] = 0;
+        l1->useful_prefetches++;
+        if (late > 0)
+        {
+            l1->late_prefetches++;
+            return (int)late;
+        }
+    }
+    return 0;
+}
+
+#endif
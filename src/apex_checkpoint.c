@@ -0,0 +1,620 @@
+/*
+ * apex_checkpoint.c
+ * Contains checkpoints of the complete simulator state and checkpoint files
+ *
+ * A checkpoint copies the registers, flags, scoreboard, pipeline latches and
+ * width, out-of-order back end, branch predictor, caches, fetch block,
+ * prefetchers, store buffer and counters of a CPU, and shares its data memory
+ * pages copy-on-write, so taking one copies no data memory. Restoring a
+ * checkpoint shares its pages again, any number of CPUs can resume from the
+ * same checkpoint.
+ *
+ * A checkpoint file is a header, the state, the valid lines of each cache
+ * level with a size, code memory and then every written data memory page
+ * prefixed by its index, in host byte order. Input files are probed for it,
+ * so a checkpoint file runs like a program.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+#define APEX_CHECKPOINT_MAGIC "APXC"
+
+/* Bump whenever the layout of the header or of APEX_Checkpoint_State changes */
+#define APEX_CHECKPOINT_VERSION 13
+
+typedef struct APEX_Checkpoint_Header
+{
+    char magic[4];             /* APEX_CHECKPOINT_MAGIC */
+    uint32_t version;          /* APEX_CHECKPOINT_VERSION */
+    uint32_t state_size;       /* sizeof(APEX_Checkpoint_State) */
+    uint32_t code_memory_size; /* Number of instructions */
+    uint32_t data_memory_size; /* Addressable data memory words */
+    uint32_t num_pages;        /* Written data memory pages that follow */
+} APEX_Checkpoint_Header;
+
+/* Valid way of a cache in a checkpoint file */
+typedef struct APEX_Checkpoint_Line
+{
+    uint32_t index; /* Of the way within the cache */
+    int32_t tag;
+    uint32_t stamp;
+    uint32_t dirty;
+    int64_t prefetched;
+} APEX_Checkpoint_Line;
+
+/* Everything in APEX_CPU that a run changes, other than data memory. The
+ * caches own copies of their lines, which a file stores apart */
+typedef struct APEX_Checkpoint_State
+{
+    int pc;
+    long long clock;
+    long long insn_completed;
+    int regs[REG_FILE_SIZE];
+    int regsStatus[REG_FILE_SIZE];
+    int reg_values[REG_FILE_SIZE];
+    unsigned char reg_writers[REG_FILE_SIZE];
+    unsigned char issue_tag;
+    int zero_flag;
+    int pos_flag;
+    int fetch_from_next_cycle;
+    int forwarding;
+    int halted;
+    int fault;
+    int width;
+    CPU_Stage fetch[APEX_MAX_WIDTH];
+    CPU_Stage decode[APEX_MAX_WIDTH];
+    CPU_Stage execute[APEX_FU_MAX_LATENCY][APEX_MAX_WIDTH];
+    CPU_Stage memory[APEX_MAX_WIDTH];
+    CPU_Stage writeback[APEX_MAX_WIDTH];
+    APEX_Unit units[APEX_FU_COUNT];
+    long long unit_ready[APEX_FU_COUNT];
+    long long execute_done;
+    int execute_count;
+    int core;
+    APEX_Ooo ooo;
+    APEX_Predictor predictor;
+    APEX_Prefetcher prefetcher;
+    APEX_Store_Buffer store_buffer;
+    APEX_Cache l1i;
+    APEX_Cache l1d;
+    APEX_Cache l2;
+    int dram_latency;
+    long long memory_ready;
+    int store_wait;
+    long long fetch_ready;
+    int fetch_block;
+    int fetch_mask;
+    int iprefetch;
+    APEX_Stats stats;
+} APEX_Checkpoint_State;
+
+struct APEX_Checkpoint
+{
+    APEX_Checkpoint_State state;
+    APEX_Memory data_memory;             /* Shares pages with the CPU */
+    const APEX_Instruction *code_memory; /* The CPU's, kept for saving */
+    int code_memory_size;
+};
+
+/* Frees the lines of the caches of a state */
+static void
+free_state(APEX_Checkpoint_State *state)
+{
+    APEX_cache_free(&state->l1i);
+    APEX_cache_free(&state->l1d);
+    APEX_cache_free(&state->l2);
+}
+
+/* Copies the state of a CPU into a zeroed one. Returns 0 on success */
+static int
+save_state(APEX_Checkpoint_State *state, const APEX_CPU *cpu)
+{
+    if (APEX_cache_copy(&state->l1i, &cpu->l1i)
+        || APEX_cache_copy(&state->l1d, &cpu->l1d)
+        || APEX_cache_copy(&state->l2, &cpu->l2))
+    {
+        free_state(state);
+        return -1;
+    }
+
+    state->pc = cpu->pc;
+    state->clock = cpu->clock;
+    state->insn_completed = cpu->insn_completed;
+    memcpy(state->regs, cpu->regs, sizeof(state->regs));
+    memcpy(state->regsStatus, cpu->regsStatus, sizeof(state->regsStatus));
+    memcpy(state->reg_values, cpu->reg_values, sizeof(state->reg_values));
+    memcpy(state->reg_writers, cpu->reg_writers, sizeof(state->reg_writers));
+    state->issue_tag = cpu->issue_tag;
+    state->zero_flag = cpu->zero_flag;
+    state->pos_flag = cpu->pos_flag;
+    state->fetch_from_next_cycle = cpu->fetch_from_next_cycle;
+    state->forwarding = cpu->forwarding;
+    state->halted = cpu->halted;
+    state->fault = cpu->fault;
+    state->width = cpu->width;
+    memcpy(state->fetch, cpu->fetch, sizeof(state->fetch));
+    memcpy(state->decode, cpu->decode, sizeof(state->decode));
+    memcpy(state->execute, cpu->execute, sizeof(state->execute));
+    memcpy(state->memory, cpu->memory, sizeof(state->memory));
+    memcpy(state->writeback, cpu->writeback, sizeof(state->writeback));
+    memcpy(state->units, cpu->units, sizeof(state->units));
+    memcpy(state->unit_ready, cpu->unit_ready, sizeof(state->unit_ready));
+    state->execute_done = cpu->execute_done;
+    state->execute_count = cpu->execute_count;
+    state->core = cpu->core;
+    state->ooo = cpu->ooo;
+    state->predictor = cpu->predictor;
+    state->prefetcher = cpu->prefetcher;
+    state->store_buffer = cpu->store_buffer;
+    state->dram_latency = cpu->dram_latency;
+    state->memory_ready = cpu->memory_ready;
+    state->store_wait = cpu->store_wait;
+    state->fetch_ready = cpu->fetch_ready;
+    state->fetch_block = cpu->fetch_block;
+    state->fetch_mask = cpu->fetch_mask;
+    state->iprefetch = cpu->iprefetch;
+    state->stats = cpu->stats;
+    return 0;
+}
+
+/* Copies a state into a CPU. Returns 0 on success */
+static int
+restore_state(APEX_CPU *cpu, const APEX_Checkpoint_State *state)
+{
+    if (APEX_cache_copy(&cpu->l1i, &state->l1i)
+        || APEX_cache_copy(&cpu->l1d, &state->l1d)
+        || APEX_cache_copy(&cpu->l2, &state->l2))
+    {
+        return -1;
+    }
+
+    cpu->pc = state->pc;
+    cpu->clock = state->clock;
+    cpu->insn_completed = state->insn_completed;
+    memcpy(cpu->regs, state->regs, sizeof(cpu->regs));
+    memcpy(cpu->regsStatus, state->regsStatus, sizeof(cpu->regsStatus));
+    memcpy(cpu->reg_values, state->reg_values, sizeof(cpu->reg_values));
+    memcpy(cpu->reg_writers, state->reg_writers, sizeof(cpu->reg_writers));
+    cpu->issue_tag = state->issue_tag;
+    cpu->zero_flag = state->zero_flag;
+    cpu->pos_flag = state->pos_flag;
+    cpu->fetch_from_next_cycle = state->fetch_from_next_cycle;
+    cpu->forwarding = state->forwarding;
+    cpu->halted = state->halted;
+    cpu->fault = state->fault;
+    cpu->width = state->width;
+    memcpy(cpu->fetch, state->fetch, sizeof(cpu->fetch));
+    memcpy(cpu->decode, state->decode, sizeof(cpu->decode));
+    memcpy(cpu->execute, state->execute, sizeof(cpu->execute));
+    memcpy(cpu->memory, state->memory, sizeof(cpu->memory));
+    memcpy(cpu->writeback, state->writeback, sizeof(cpu->writeback));
+    memcpy(cpu->units, state->units, sizeof(cpu->units));
+    memcpy(cpu->unit_ready, state->unit_ready, sizeof(cpu->unit_ready));
+    cpu->execute_done = state->execute_done;
+    cpu->execute_count = state->execute_count;
+    cpu->core = state->core;
+    cpu->ooo = state->ooo;
+    cpu->predictor = state->predictor;
+    cpu->prefetcher = state->prefetcher;
+    cpu->store_buffer = state->store_buffer;
+    cpu->dram_latency = state->dram_latency;
+    cpu->memory_ready = state->memory_ready;
+    cpu->store_wait = state->store_wait;
+    cpu->fetch_ready = state->fetch_ready;
+    cpu->fetch_block = state->fetch_block;
+    cpu->fetch_mask = state->fetch_mask;
+    cpu->iprefetch = state->iprefetch;
+    cpu->stats = state->stats;
+    return 0;
+}
+
+/*
+ * Takes a checkpoint of a CPU. Data memory is shared, not copied. The
+ * checkpoint refers to the CPU's code memory, it can be saved only while that
+ * is loaded.
+ */
+APEX_Checkpoint *
+APEX_checkpoint_take(const APEX_CPU *cpu)
+{
+    APEX_Checkpoint *checkpoint;
+
+    checkpoint = calloc(1, sizeof(APEX_Checkpoint));
+    if (!checkpoint)
+    {
+        return NULL;
+    }
+
+    if (APEX_memory_share(&checkpoint->data_memory, &cpu->data_memory))
+    {
+        free(checkpoint);
+        return NULL;
+    }
+
+    if (save_state(&checkpoint->state, cpu))
+    {
+        APEX_memory_free(&checkpoint->data_memory);
+        free(checkpoint);
+        return NULL;
+    }
+    checkpoint->code_memory = cpu->code_memory;
+    checkpoint->code_memory_size = cpu->code_memory_size;
+    return checkpoint;
+}
+
+/*
+ * Resets a CPU running the same program to a checkpoint, including its
+ * forwarding policy. The mode, cycle limit and trace of the CPU are kept.
+ * Returns 0 on success.
+ */
+int
+APEX_checkpoint_restore(APEX_CPU *cpu, const APEX_Checkpoint *checkpoint)
+{
+    APEX_Memory data_memory;
+
+    if (cpu->code_memory_size != checkpoint->code_memory_size)
+    {
+        fprintf(stderr, "APEX_Error: Checkpoint was taken of a different "
+                        "program\n");
+        return -1;
+    }
+
+    if (APEX_memory_share(&data_memory, &checkpoint->data_memory))
+    {
+        return -1;
+    }
+
+    if (restore_state(cpu, &checkpoint->state))
+    {
+        APEX_memory_free(&data_memory);
+        return -1;
+    }
+    APEX_memory_free(&cpu->data_memory);
+    cpu->data_memory = data_memory;
+    return 0;
+}
+
+void
+APEX_checkpoint_free(APEX_Checkpoint *checkpoint)
+{
+    if (checkpoint)
+    {
+        APEX_memory_free(&checkpoint->data_memory);
+        free_state(&checkpoint->state);
+        free(checkpoint);
+    }
+}
+
+/* Writes the number of valid ways of a cache, then each of them. Returns TRUE
+ * on success */
+static int
+write_cache(FILE *fp, const APEX_Cache *cache)
+{
+    const int lines = APEX_cache_lines(cache);
+    APEX_Checkpoint_Line line;
+    uint32_t count = 0;
+    int i;
+
+    for (i = 0; i < lines; ++i)
+    {
+        count += cache->tags[i] != APEX_CACHE_INVALID;
+    }
+    if (fwrite(&count, sizeof(count), 1, fp) != 1)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < lines; ++i)
+    {
+        if (cache->tags[i] != APEX_CACHE_INVALID)
+        {
+            line.index = i;
+            line.tag = cache->tags[i];
+            line.stamp = cache->stamps[i];
+            line.prefetched = cache->prefetched[i];
+            line.dirty = cache->dirty[i];
+            if (fwrite(&line, sizeof(line), 1, fp) != 1)
+            {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Writes a checkpoint file. Returns 0 on success.
+ */
+int
+APEX_checkpoint_save(const APEX_Checkpoint *checkpoint, const char *filename)
+{
+    const APEX_Memory *mem = &checkpoint->data_memory;
+    APEX_Checkpoint_Header header;
+    uint32_t index;
+    FILE *fp;
+    int i, ok;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, APEX_CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version = APEX_CHECKPOINT_VERSION;
+    header.state_size = sizeof(APEX_Checkpoint_State);
+    header.code_memory_size = checkpoint->code_memory_size;
+    header.data_memory_size = mem->size;
+    for (i = 0; i < mem->num_pages; ++i)
+    {
+        header.num_pages += mem->pages[i] != NULL;
+    }
+
+    fp = fopen(filename, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create checkpoint %s\n",
+                filename);
+        return -1;
+    }
+
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1
+         && fwrite(&checkpoint->state, sizeof(checkpoint->state), 1, fp) == 1
+         && write_cache(fp, &checkpoint->state.l1i)
+         && write_cache(fp, &checkpoint->state.l1d)
+         && write_cache(fp, &checkpoint->state.l2)
+         && fwrite(checkpoint->code_memory, sizeof(APEX_Instruction),
+                   checkpoint->code_memory_size, fp)
+                == (size_t)checkpoint->code_memory_size;
+
+    for (i = 0; ok && i < mem->num_pages; ++i)
+    {
+        if (mem->pages[i])
+        {
+            index = i;
+            ok = fwrite(&index, sizeof(index), 1, fp) == 1
+                 && fwrite(mem->pages[i]->words, sizeof(mem->pages[i]->words),
+                           1, fp) == 1;
+        }
+    }
+
+    if (fclose(fp) != 0 || !ok)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write checkpoint %s\n",
+                filename);
+        remove(filename);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Returns TRUE if the file starts with the checkpoint magic number
+ */
+int
+APEX_checkpoint_probe(const char *filename)
+{
+    char magic[4];
+    FILE *fp;
+    int ret = FALSE;
+
+    fp = fopen(filename, "rb");
+    if (fp)
+    {
+        ret = fread(magic, sizeof(magic), 1, fp) == 1
+              && memcmp(magic, APEX_CHECKPOINT_MAGIC, sizeof(magic)) == 0;
+        fclose(fp);
+    }
+    return ret;
+}
+
+/* Returns TRUE if every unit of a loaded state has a latency in range */
+static int
+units_valid(const APEX_Unit *units)
+{
+    int i;
+
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        if (units[i].latency < 1 || units[i].latency > APEX_FU_MAX_LATENCY)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* Returns TRUE if count latches hold valid instructions, see
+ * APEX_instruction_valid */
+static int
+stages_valid(const CPU_Stage *stages, int count)
+{
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (!APEX_instruction_valid(stages[i].opcode, stages[i].rd,
+                                    stages[i].rs1, stages[i].rs2))
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Returns TRUE if the register scoreboard and every pipeline latch of a
+ * loaded state are valid, empty latches included as a run leaves earlier
+ * instructions in them
+ */
+static int
+pipeline_valid(const APEX_Checkpoint_State *state)
+{
+    int i;
+
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        if ((unsigned int)state->regsStatus[i] > REG_FORWARDED)
+        {
+            return FALSE;
+        }
+    }
+    return stages_valid(state->fetch, APEX_MAX_WIDTH)
+           && stages_valid(state->decode, APEX_MAX_WIDTH)
+           && stages_valid(&state->execute[0][0],
+                           APEX_FU_MAX_LATENCY * APEX_MAX_WIDTH)
+           && stages_valid(state->memory, APEX_MAX_WIDTH)
+           && stages_valid(state->writeback, APEX_MAX_WIDTH);
+}
+
+/*
+ * Reads the valid ways of a loaded cache into its lines, allocated with every
+ * way invalid. Returns TRUE on success.
+ */
+static int
+read_cache(FILE *fp, APEX_Cache *cache)
+{
+    APEX_Checkpoint_Line line;
+    uint32_t i, count;
+
+    if (fread(&count, sizeof(count), 1, fp) != 1
+        || count > (uint32_t)APEX_cache_lines(cache))
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (fread(&line, sizeof(line), 1, fp) != 1
+            || line.index >= (uint32_t)APEX_cache_lines(cache)
+            || line.tag == APEX_CACHE_INVALID)
+        {
+            return FALSE;
+        }
+        cache->tags[line.index] = line.tag;
+        cache->stamps[line.index] = line.stamp;
+        cache->prefetched[line.index] = line.prefetched;
+        cache->dirty[line.index] = line.dirty != 0;
+    }
+    return TRUE;
+}
+
+/*
+ * Loads a checkpoint file into a new CPU: its code memory, data memory and
+ * state. Returns 0 on success.
+ */
+int
+APEX_checkpoint_load(APEX_CPU *cpu, const char *filename)
+{
+    APEX_Checkpoint_Header header;
+    APEX_Checkpoint_State state;
+    APEX_Page *page;
+    uint32_t i, index;
+    FILE *fp;
+    int failed;
+
+    fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1
+        || memcmp(header.magic, APEX_CHECKPOINT_MAGIC, sizeof(header.magic))
+               != 0
+        || header.version != APEX_CHECKPOINT_VERSION
+        || header.state_size != sizeof(APEX_Checkpoint_State))
+    {
+        fprintf(stderr, "APEX_Error: %s is not a version %d checkpoint\n",
+                filename, APEX_CHECKPOINT_VERSION);
+        fclose(fp);
+        return -1;
+    }
+
+    if (header.code_memory_size == 0 || header.code_memory_size > INT32_MAX
+        || header.data_memory_size == 0 || header.data_memory_size > INT32_MAX
+        || fread(&state, sizeof(state), 1, fp) != 1
+        || (unsigned int)state.forwarding > APEX_FORWARD_FULL
+        || state.width < 1 || state.width > APEX_MAX_WIDTH
+        || (unsigned int)state.execute_count > (unsigned int)state.width
+        || !units_valid(state.units) || !pipeline_valid(&state)
+        || (unsigned int)state.core > APEX_CORE_OOO
+        || !APEX_ooo_valid(&state.ooo)
+        || !APEX_predictor_valid(&state.predictor)
+        || !APEX_prefetcher_valid(&state.prefetcher)
+        || !APEX_store_buffer_valid(&state.store_buffer)
+        || !APEX_cache_valid(&state.l1i) || !APEX_cache_valid(&state.l1d)
+        || !APEX_cache_valid(&state.l2) || state.dram_latency < 1
+        || state.dram_latency > APEX_CACHE_MAX_LATENCY
+        || (unsigned int)state.iprefetch > APEX_PREFETCH_NEXTLINE
+        || APEX_memory_init(&cpu->data_memory, header.data_memory_size))
+    {
+        fprintf(stderr, "APEX_Error: %s is truncated or corrupt\n", filename);
+        fclose(fp);
+        return -1;
+    }
+
+    /* The lines the caches were saved with are gone, theirs follow the state */
+    failed = APEX_cache_alloc(&state.l1i);
+    failed |= APEX_cache_alloc(&state.l1d);
+    failed |= APEX_cache_alloc(&state.l2);
+    if (failed || !read_cache(fp, &state.l1i) || !read_cache(fp, &state.l1d)
+        || !read_cache(fp, &state.l2))
+    {
+        goto corrupt;
+    }
+
+    cpu->code_memory_size = header.code_memory_size;
+    cpu->code_memory = malloc(header.code_memory_size
+                              * sizeof(APEX_Instruction));
+    if (!cpu->code_memory
+        || fread(cpu->code_memory, sizeof(APEX_Instruction),
+                 header.code_memory_size, fp) != header.code_memory_size)
+    {
+        goto corrupt;
+    }
+    for (i = 0; i < header.code_memory_size; ++i)
+    {
+        if (!APEX_instruction_valid(cpu->code_memory[i].opcode,
+                                    cpu->code_memory[i].rd,
+                                    cpu->code_memory[i].rs1,
+                                    cpu->code_memory[i].rs2))
+        {
+            goto corrupt;
+        }
+    }
+
+    for (i = 0; i < header.num_pages; ++i)
+    {
+        if (fread(&index, sizeof(index), 1, fp) != 1
+            || index >= (uint32_t)cpu->data_memory.num_pages
+            || cpu->data_memory.pages[index])
+        {
+            goto corrupt;
+        }
+
+        page = APEX_memory_touch(&cpu->data_memory,
+                                 (int)(index << APEX_PAGE_SHIFT));
+        if (!page || fread(page->words, sizeof(page->words), 1, fp) != 1)
+        {
+            goto corrupt;
+        }
+    }
+
+    if (restore_state(cpu, &state))
+    {
+        goto failed;
+    }
+    free_state(&state);
+    fclose(fp);
+    return 0;
+
+corrupt:
+    fprintf(stderr, "APEX_Error: %s is truncated or corrupt\n", filename);
+failed:
+    free_state(&state);
+    free(cpu->code_memory);
+    cpu->code_memory = NULL;
+    APEX_memory_free(&cpu->data_memory);
+    fclose(fp);
+    return -1;
+}
@@ -0,0 +1,2528 @@
+/*
+ * apex_cpu.c
+ * Contains APEX cpu pipeline implementation
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_isa.h"
+#include "apex_macros.h"
+
+/*
+ * Pipeline stages take display, the forwarding policy and the width as
+ * compile-time constants and are always inlined into one of twelve
+ * specialized run loops, so the loops used without display have no tracing
+ * calls and no per-cycle display checks, each loop carries only its own
+ * policy's interlock, and a 1-wide pipeline has no loops over groups. With
+ * display the stages record into cpu->trace, which buffers and prints the
+ * output. The out-of-order back end of apex_ooo.c has a quiet and a display
+ * loop of its own.
+ */
+#define PIPELINE_STAGE static inline __attribute__((always_inline))
+
+/* Converts the PC(4000 series) into array index for code memory
+ *
+ * Note: You are not supposed to edit this function
+ */
+static int
+get_code_memory_index_from_pc(const int pc)
+{
+    return (pc - 4000) / 4;
+}
+
+/* Debug function which prints the register file
+ *
+ * Note: You are not supposed to edit this function
+ */
+static void
+print_reg_file(const APEX_CPU *cpu)
+{
+    int i;
+
+    printf("----------\n%s\n----------\n", "Registers:");
+
+    for (int i = 0; i < REG_FILE_SIZE / 2; ++i)
+    {
+        printf("R%-3d[%-3d] ", i, cpu->regs[i]);
+    }
+
+    printf("\n");
+
+    for (i = (REG_FILE_SIZE / 2); i < REG_FILE_SIZE; ++i)
+    {
+        printf("R%-3d[%-3d] ", i, cpu->regs[i]);
+    }
+
+    printf("\n");
+}
+
+/*
+ * Predicts the branch or jump in the fetch latch, if it is one, and records
+ * where fetch is to go next
+ */
+PIPELINE_STAGE void
+predict_branch(APEX_CPU *cpu, CPU_Stage *stage)
+{
+    const int branch = apex_isa[stage->opcode].branch;
+
+    if (branch != APEX_BRANCH_NEVER)
+    {
+        cpu->stats.btb_lookups++;
+        stage->predicted_taken = APEX_predictor_predict(
+            &cpu->predictor, stage->pc, branch != APEX_BRANCH_ALWAYS,
+            stage->imm < 0, &stage->predicted_pc, &cpu->stats.btb_hits);
+    }
+}
+
+/* Returns the PC fetched after the instruction in a fetch latch */
+PIPELINE_STAGE int
+next_fetch_pc(const CPU_Stage *stage)
+{
+    return stage->predicted_taken ? stage->predicted_pc : stage->pc + 4;
+}
+
+/*
+ * Fetches a group of up to width consecutive instructions from the PC on. A
+ * group ends early after a branch predicted taken, its target starts the next
+ * one, after HALT and at the end of the block fetch reads a cycle, see
+ * fetch_mask.
+ */
+PIPELINE_STAGE void
+fetch_group(APEX_CPU *cpu, const int width)
+{
+    /* Fetched when control leaves code memory, which ends the run */
+    static const APEX_Instruction end_of_code = {.opcode = OPCODE_HALT};
+    const APEX_Instruction *current_ins;
+    CPU_Stage *stage;
+    int pc = cpu->pc;
+    int i, index;
+
+    for (i = 0; i < width;)
+    {
+        stage = &cpu->fetch[i++];
+
+        /* Store current PC in fetch latch */
+        stage->pc = pc;
+
+        /* Index into code memory using this pc and copy all instruction fields
+         * into fetch latch  */
+        index = cpu->code_memory_size;
+        if (pc >= 4000 && (pc - 4000) % 4 == 0)
+        {
+            index = get_code_memory_index_from_pc(pc);
+        }
+        current_ins = &end_of_code;
+        if (index < cpu->code_memory_size)
+        {
+            current_ins = &cpu->code_memory[index];
+        }
+        stage->opcode = current_ins->opcode;
+        stage->rd = current_ins->rd;
+        stage->rs1 = current_ins->rs1;
+        stage->rs2 = current_ins->rs2;
+        stage->imm = current_ins->imm;
+        stage->has_insn = TRUE;
+        stage->stall = 0;
+        stage->predicted_taken = FALSE;
+        if (cpu->predictor.kind != APEX_BP_NONE)
+        {
+            predict_branch(cpu, stage);
+        }
+
+        if (stage->predicted_taken || stage->opcode == OPCODE_HALT
+            || ((index + 1) & cpu->fetch_mask) == 0)
+        {
+            break;
+        }
+        pc = next_fetch_pc(stage);
+    }
+
+    for (; i < width; ++i)
+    {
+        cpu->fetch[i].has_insn = FALSE;
+    }
+}
+
+/*
+ * Looks the line of the next fetch group up in the instruction cache. A miss
+ * holds fetch for its cycles, after which the group is fetched without
+ * another lookup, and with the next-line prefetcher also brings in the line
+ * after it. Returns TRUE while fetch waits.
+ */
+PIPELINE_STAGE int
+fetch_miss(APEX_CPU *cpu)
+{
+    int index, line, cycles;
+
+    if (cpu->fetch_ready)
+    {
+        if (cpu->fetch_ready > cpu->clock)
+        {
+            return TRUE;
+        }
+        cpu->fetch_ready = 0;
+        return FALSE;
+    }
+
+    /* Fetching outside code memory ends the run, there is nothing to miss */
+    if (cpu->pc < 4000 || (cpu->pc - 4000) % 4 != 0
+        || get_code_memory_index_from_pc(cpu->pc) >= cpu->code_memory_size)
+    {
+        return FALSE;
+    }
+    index = get_code_memory_index_from_pc(cpu->pc);
+
+    cycles = APEX_cache_access(&cpu->l1i, &cpu->l2, cpu->dram_latency, index,
+                               FALSE, cpu->clock);
+    if (!cycles)
+    {
+        return FALSE;
+    }
+
+    line = index >> cpu->l1i.line_shift;
+    if (cpu->iprefetch == APEX_PREFETCH_NEXTLINE
+        && (line + 1) << cpu->l1i.line_shift < cpu->code_memory_size)
+    {
+        APEX_cache_prefetch(&cpu->l1i, &cpu->l2, cpu->dram_latency, line + 1,
+                            cpu->clock);
+    }
+    cpu->fetch_ready = cpu->clock + cycles;
+    return TRUE;
+}
+
+/* Copies the fetch group to decode and moves the PC past it */
+PIPELINE_STAGE void
+fetch_to_decode(APEX_CPU *cpu, const int width)
+{
+    int i;
+
+    for (i = 0; i < width; ++i)
+    {
+        cpu->decode[i] = cpu->fetch[i];
+        if (cpu->fetch[i].has_insn)
+        {
+            cpu->pc = next_fetch_pc(&cpu->fetch[i]);
+        }
+    }
+}
+
+/*
+ * Fetch Stage of APEX Pipeline
+ *
+ * A fetched group moves to decode as a whole, once decode has issued all of
+ * the previous one. Fetch waits, and decode starves, while the instruction
+ * cache misses.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+PIPELINE_STAGE void
+APEX_fetch(APEX_CPU *cpu, const int display, const int width)
+{
+    CPU_Stage *const fetch = cpu->fetch;
+    int i, last = -1;
+
+    if (fetch[0].has_insn && !fetch[0].stall)
+    {
+        /* This fetches new branch target instruction from next cycle */
+        if (cpu->fetch_from_next_cycle == TRUE)
+        {
+            cpu->fetch_from_next_cycle = FALSE;
+            cpu->stats.flush_bubble_cycles++;
+
+            /* Skip this cycle*/
+            return;
+        }
+
+        if (cpu->l1i.config.size && fetch_miss(cpu))
+        {
+            if (display)
+            {
+                APEX_trace_stage(cpu->trace, APEX_TRACE_FETCH, 0, cpu->pc,
+                                 TRUE);
+            }
+            cpu->stats.fetch_starved_cycles++;
+            return;
+        }
+
+        fetch_group(cpu, width);
+
+        if(!cpu->decode[0].stall){
+
+            /* Copy data from fetch latch to decode latch*/
+            fetch_to_decode(cpu, width);
+            
+        } else {
+
+            fetch[0].stall = 1;
+        }
+    } else if(fetch[0].stall) { /*Fetch is stalled*/
+        if(!cpu->decode[0].stall){
+            fetch[0].stall = 0;
+            fetch_to_decode(cpu, width);
+        }
+    }
+    cpu->stats.fetch_stall_cycles += fetch[0].stall;
+
+    for (i = 0; i < width && fetch[i].has_insn; ++i)
+    {
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_FETCH, i, fetch[i].pc,
+                             fetch[0].stall);
+        }
+        last = fetch[i].opcode;
+    }
+
+    /* Stop fetching new instructions if HALT, the last of its group, is
+     * fetched */
+    if (last == OPCODE_HALT && !cpu->decode[0].stall)
+    {
+        fetch[0].has_insn = FALSE;
+    }
+}
+
+/*
+ * Returns TRUE if decode can read a source register this cycle: no
+ * instruction in flight writes it, or the result of the youngest one is being
+ * forwarded
+ */
+PIPELINE_STAGE int
+is_src_ready(const APEX_CPU *cpu, const int reg)
+{
+    return cpu->regsStatus[reg] != REG_BUSY;
+}
+
+_Static_assert((APEX_FU_MAX_LATENCY + 2) * APEX_MAX_WIDTH < 256,
+               "Execute, memory and writeback hold fewer instructions than "
+               "there are tags");
+_Static_assert(sizeof(CPU_Stage) == 32, "CPU_Stage is 32 bytes");
+
+/*
+ * Returns TRUE if an instruction is the youngest in flight writing reg. Only
+ * that one sets its scoreboard state, older writers still write the register
+ * file in order. Tags wrap around, which is safe while fewer instructions
+ * than tags can be in flight.
+ */
+PIPELINE_STAGE int
+is_last_writer(const APEX_CPU *cpu, const CPU_Stage *stage, const int reg)
+{
+    return cpu->reg_writers[reg] == stage->tag;
+}
+
+/* Reads a ready source register, from the forwarding path if it is on it */
+PIPELINE_STAGE int
+read_src(const APEX_CPU *cpu, const int reg, const int forwarding)
+{
+    if (forwarding != APEX_FORWARD_NONE
+        && cpu->regsStatus[reg] == REG_FORWARDED)
+    {
+        return cpu->reg_values[reg];
+    }
+    return cpu->regs[reg];
+}
+
+/*
+ * Dispatches on an opcode to ISA_STAGE(op), defined by the caller, with op
+ * the opcode's row of apex_isa. Each case inlines the stage with a constant
+ * row, undefined opcodes run it with the row of NOP. Execute, which does the
+ * most per opcode, is dispatched this way, the other stages only test a few
+ * bits of the row and look it up.
+ */
+#define ISA_CASE(opcode, ...)                                                  \
+    case opcode:                                                               \
+        ISA_STAGE(&apex_isa[opcode]);                                          \
+        break;
+
+#define ISA_SWITCH(opcode)                                                     \
+    switch (opcode)                                                            \
+    {                                                                          \
+        APEX_ISA(ISA_CASE)                                                     \
+        default:                                                               \
+            ISA_STAGE(&apex_isa[OPCODE_NOP]);                                  \
+            break;                                                             \
+    }
+
+/* Returns the first clock at which decode can issue an instruction */
+PIPELINE_STAGE long long
+issue_clock(const APEX_CPU *cpu, const CPU_Stage *stage)
+{
+    return cpu->unit_ready[apex_isa[stage->opcode].unit];
+}
+
+/*
+ * Reads the source registers of the instruction in decode and claims its
+ * destinations, or stalls it if a source is busy. A destination still written
+ * by an earlier instruction in flight does not stall it: the two complete in
+ * order, and the later claim makes it the one readers wait for.
+ */
+PIPELINE_STAGE void
+read_operands(APEX_CPU *cpu, CPU_Stage *stage, const APEX_Opcode *op,
+              const int forwarding)
+{
+    const int effects = op->effects;
+
+    if (((effects & APEX_OP_RS1) && !is_src_ready(cpu, stage->rs1))
+        || ((effects & APEX_OP_RS2) && !is_src_ready(cpu, stage->rs2)))
+    {
+        stage->stall = 1;
+        return;
+    }
+
+    if (effects & APEX_OP_RS1)
+    {
+        stage->rs1_value = read_src(cpu, stage->rs1, forwarding);
+    }
+    if (effects & APEX_OP_RS2)
+    {
+        stage->rs2_value = read_src(cpu, stage->rs2, forwarding);
+    }
+    stage->tag = ++cpu->issue_tag;
+    if (effects & APEX_OP_RD)
+    {
+        cpu->regsStatus[stage->rd] = REG_BUSY;
+        cpu->reg_writers[stage->rd] = stage->tag;
+    }
+    if (effects & APEX_OP_RS1_INC)
+    {
+        cpu->regsStatus[stage->rs1] = REG_BUSY;
+        cpu->reg_writers[stage->rs1] = stage->tag;
+    }
+    stage->stall = 0;
+}
+
+/*
+ * Moves an instruction in decode to execute, into the group of the clock its
+ * unit completes it in, and delays later issues so that they complete with
+ * it while that group has room, else after it. Until it completes, its unit
+ * takes nothing else if not pipelined, and nothing issues behind it if it is
+ * a branch, so nothing past a branch is in flight when it redirects fetch.
+ */
+PIPELINE_STAGE void
+issue(APEX_CPU *cpu, CPU_Stage *stage, const APEX_Opcode *op)
+{
+    const int unit = op->unit;
+    const long long done = cpu->clock + cpu->units[unit].latency;
+    const int branch = op->branch != APEX_BRANCH_NEVER;
+    long long ready;
+    int i, full;
+
+    if (done != cpu->execute_done)
+    {
+        cpu->execute_done = done;
+        cpu->execute_count = 0;
+    }
+    cpu->execute[done & APEX_FU_MASK][cpu->execute_count++] = *stage;
+    full = cpu->execute_count >= cpu->width;
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        ready = done - cpu->units[i].latency + full;
+        if (branch || (i == unit && !cpu->units[i].pipelined))
+        {
+            ready = done;
+        }
+        if (cpu->unit_ready[i] < ready)
+        {
+            cpu->unit_ready[i] = ready;
+        }
+    }
+    cpu->stats.unit_ops[unit]++;
+    stage->has_insn = FALSE;
+}
+
+/* Issues an instruction in decode, or holds it another cycle */
+PIPELINE_STAGE void
+decode_op(APEX_CPU *cpu, CPU_Stage *stage, const APEX_Opcode *op,
+          const int forwarding)
+{
+    if (cpu->unit_ready[op->unit] > cpu->clock)
+    {
+        /* Held before reading its operands, it claims no register */
+        stage->stall = 1;
+        cpu->stats.structural_stall_cycles++;
+    }
+    else
+    {
+        read_operands(cpu, stage, op, forwarding);
+        cpu->stats.raw_stall_cycles += stage->stall;
+    }
+
+    if (!stage->stall)
+    {
+        issue(cpu, stage, op);
+    }
+}
+
+/*
+ * Decode Stage of APEX Pipeline
+ *
+ * An instruction waits here until its unit can take it and every source
+ * register is ready. The group issues in order, so those issued before it in
+ * the same cycle count as in flight, and it holds the ones after it.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+PIPELINE_STAGE void
+APEX_decode(APEX_CPU *cpu, const int display, const int forwarding,
+            const int width)
+{
+    CPU_Stage *const stage = cpu->decode;
+    int i, issued = 0;
+
+    for (i = 0; i < width && stage[i].has_insn; ++i)
+    {
+        if (issued == i)
+        {
+            decode_op(cpu, &stage[i], &apex_isa[stage[i].opcode], forwarding);
+            issued += !stage[i].stall;
+        }
+        else
+        {
+            stage[i].stall = 1;
+        }
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_DECODE, i, stage[i].pc,
+                             stage[i].stall);
+        }
+    }
+
+    if (issued)
+    {
+        cpu->stats.issued[issued - 1]++;
+
+        /* The held instructions move up to the front of the group */
+        if (issued < i)
+        {
+            for (i = 0; i + issued < width; ++i)
+            {
+                stage[i] = stage[i + issued];
+            }
+            for (; i < width; ++i)
+            {
+                stage[i].has_insn = FALSE;
+            }
+        }
+    }
+}
+
+/*
+ * Redirects fetch to where a mispredicted branch or jump really goes. The
+ * instructions in decode and fetch are dismissed and fetching resumes from
+ * there next cycle.
+ */
+PIPELINE_STAGE void
+APEX_redirect(APEX_CPU *cpu, const int target)
+{
+    /* Calculate new PC, and send it to fetch unit */
+    cpu->pc = target;
+
+    /* Since we are using reverse callbacks for pipeline stages, this will
+     * prevent the new instruction from being fetched in the current cycle */
+    cpu->fetch_from_next_cycle = TRUE;
+
+    int i;
+
+    /* Flush previous stages, including any stall they were in */
+    cpu->stats.branch_flushes++;
+    for (i = 0; i < cpu->width && cpu->decode[i].has_insn; ++i)
+    {
+        cpu->decode[i].has_insn = FALSE;
+        cpu->stats.flushed_insns++;
+    }
+    cpu->decode[0].stall = 0;
+    cpu->fetch[0].stall = 0;
+
+    /* A miss on the wrong path no longer holds fetch, its line still fills */
+    cpu->fetch_ready = 0;
+
+    /* Make sure fetch stage is enabled to start fetching from new PC */
+    cpu->fetch[0].has_insn = TRUE;
+}
+
+/* Redirects fetch for the out-of-order core, see APEX_redirect */
+void
+APEX_cpu_redirect(APEX_CPU *cpu, int target)
+{
+    APEX_redirect(cpu, target);
+}
+
+/*
+ * Sets the scoreboard state of the registers an instruction computes by the
+ * end of execute, its result and incremented rs1, unless a later instruction
+ * in flight writes them too. Forwarded values are also copied to reg_values.
+ * A loaded rd only has its value after memory and is left alone, as is an
+ * rs1 the same load overwrites.
+ */
+PIPELINE_STAGE void
+forward_result(APEX_CPU *cpu, const CPU_Stage *stage, const APEX_Opcode *op,
+               const int status)
+{
+    const int effects = op->effects;
+
+    if ((effects & APEX_OP_RS1_INC)
+        && !((effects & APEX_OP_LOAD) && stage->rd == stage->rs1)
+        && is_last_writer(cpu, stage, stage->rs1))
+    {
+        cpu->reg_values[stage->rs1] = stage->rs1_value;
+        cpu->regsStatus[stage->rs1] = status;
+    }
+
+    if ((effects & APEX_OP_RD) && !(effects & APEX_OP_LOAD)
+        && is_last_writer(cpu, stage, stage->rd))
+    {
+        cpu->reg_values[stage->rd] = stage->result_buffer;
+        cpu->regsStatus[stage->rd] = status;
+    }
+}
+
+/*
+ * Returns the oldest group in execute, the next one to complete, or NULL if
+ * execute is empty
+ */
+static CPU_Stage *
+oldest_in_execute(APEX_CPU *cpu)
+{
+    long long clock;
+
+    for (clock = cpu->clock; clock <= cpu->execute_done; ++clock)
+    {
+        if (cpu->execute[clock & APEX_FU_MASK][0].has_insn)
+        {
+            return cpu->execute[clock & APEX_FU_MASK];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Resolves a branch or jump in execute, trains the predictor with it and
+ * redirects fetch if it was fetched past the wrong way: taken and not
+ * followed to its target, or followed and not taken.
+ */
+PIPELINE_STAGE void
+resolve_branch(APEX_CPU *cpu, const CPU_Stage *stage, const APEX_Opcode *op)
+{
+    const int taken
+        = apex_branch_taken(op->branch, cpu->zero_flag, cpu->pos_flag);
+    const int target = apex_alu(APEX_ALU_ADD,
+                                (op->effects & APEX_OP_RS1) ? stage->rs1_value
+                                                            : stage->pc,
+                                stage->imm);
+
+    cpu->stats.branches++;
+    cpu->stats.taken_branches += taken;
+    if (cpu->predictor.kind != APEX_BP_NONE)
+    {
+        APEX_predictor_update(&cpu->predictor, stage->pc,
+                              op->branch != APEX_BRANCH_ALWAYS, taken, target);
+    }
+
+    if (taken ? !stage->predicted_taken || stage->predicted_pc != target
+              : stage->predicted_taken)
+    {
+        cpu->stats.mispredictions++;
+        APEX_redirect(cpu, taken ? target : stage->pc + 4);
+    }
+}
+
+/*
+ * Completes an instruction in execute: computes its result or address and
+ * its incremented rs1, sets the flags and resolves a branch
+ */
+PIPELINE_STAGE void
+execute_op(APEX_CPU *cpu, CPU_Stage *stage, const APEX_Opcode *op,
+           const int forwarding)
+{
+    const int effects = op->effects;
+    const int b = (effects & APEX_OP_IMM) ? stage->imm : stage->rs2_value;
+    const int result = apex_alu(op->alu, stage->rs1_value, b);
+
+    if (effects & (APEX_OP_LOAD | APEX_OP_STORE))
+    {
+        stage->memory_address = result;
+    }
+    else if (op->alu != APEX_ALU_NONE)
+    {
+        stage->result_buffer = result;
+    }
+
+    if (effects & APEX_OP_RS1_INC)
+    {
+        stage->rs1_value = apex_alu(APEX_ALU_ADD, stage->rs1_value, 4);
+    }
+
+    /* Any non-zero result sets pos_flag, negative ones included */
+    if (op->cc == APEX_CC_RESULT)
+    {
+        cpu->zero_flag = result == 0;
+        cpu->pos_flag = result != 0;
+    }
+    else if (op->cc == APEX_CC_COMPARE)
+    {
+        cpu->zero_flag = stage->rs1_value == stage->rs2_value;
+        cpu->pos_flag = stage->rs1_value > stage->rs2_value;
+    }
+
+    if (op->branch != APEX_BRANCH_NEVER)
+    {
+        resolve_branch(cpu, stage, op);
+    }
+
+    /* Results are forwarded to decode from the output of execute */
+    if (forwarding != APEX_FORWARD_NONE)
+    {
+        forward_result(cpu, stage, op, REG_FORWARDED);
+    }
+}
+
+/*
+ * Execute Stage of APEX Pipeline
+ *
+ * An instruction spends the latency of its unit here and takes effect in its
+ * last cycle, in the order instructions were issued.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+PIPELINE_STAGE void
+APEX_execute(APEX_CPU *cpu, const int display, const int forwarding,
+             const int width)
+{
+    CPU_Stage *group = cpu->execute[cpu->clock & APEX_FU_MASK];
+    CPU_Stage *stage;
+    int i;
+
+    /* Only the group completing this cycle has its results */
+    for (i = 0; i < width && group[i].has_insn; ++i)
+    {
+        /* Copy data from execute latch to memory latch, complete it there */
+        cpu->memory[i] = group[i];
+        group[i].has_insn = FALSE;
+        stage = &cpu->memory[i];
+
+#define ISA_STAGE(op) execute_op(cpu, stage, op, forwarding)
+        ISA_SWITCH(stage->opcode)
+#undef ISA_STAGE
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_EXECUTE, i, stage->pc,
+                             stage->stall);
+        }
+    }
+
+    if (display && !i && (group = oldest_in_execute(cpu)))
+    {
+        /* Shows the next group to complete while units are busy */
+        for (i = 0; i < width && group[i].has_insn; ++i)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_EXECUTE, i, group[i].pc,
+                             group[i].stall);
+        }
+    }
+}
+
+/*
+ * Looks the address of a load or store at pc up in the data cache, at its
+ * memory access in either back end, and trains the data prefetcher with a
+ * load. Returns the cycles the access takes beyond an L1 hit. The caches of
+ * a system's cores are kept coherent, and take no prefetcher.
+ */
+int
+APEX_cpu_cache_access(APEX_CPU *cpu, int pc, int address, int write)
+{
+    const int misses = cpu->l1d.misses;
+    int cycles;
+
+    if (cpu->system)
+    {
+        return APEX_system_cache_access(cpu->system, address, write);
+    }
+
+    cycles = APEX_cache_access(&cpu->l1d, &cpu->l2, cpu->dram_latency,
+                               address, write, cpu->clock);
+
+    if (!write && cpu->prefetcher.kind != APEX_PREFETCH_NONE)
+    {
+        APEX_prefetch_train(&cpu->prefetcher, &cpu->l1d, &cpu->l2,
+                            cpu->dram_latency, cpu->data_memory.size, pc,
+                            address, cpu->l1d.misses != misses, cpu->clock);
+    }
+    return cycles;
+}
+
+/*
+ * Puts a store at pc to address in the store buffer, looking it up in the
+ * data cache for the cycles its drain takes beyond an L1 hit. Returns the
+ * cycles it waits for space first.
+ */
+int
+APEX_cpu_buffer_store(APEX_CPU *cpu, int pc, int address)
+{
+    const int cycles = cpu->l1d.config.size
+                           ? APEX_cpu_cache_access(cpu, pc, address, TRUE)
+                           : 0;
+
+    return APEX_store_buffer_push(&cpu->store_buffer, address, cycles,
+                                  cpu->clock);
+}
+
+/*
+ * Returns the cycles the access of a load or store in memory holds it, and
+ * sets store_wait if they are a wait for store buffer space. With a store
+ * buffer a store enters it and a load of an address it holds is forwarded,
+ * other accesses look the data cache up.
+ */
+PIPELINE_STAGE int
+memory_cycles(APEX_CPU *cpu, const CPU_Stage *stage, const int store)
+{
+    cpu->store_wait = store && cpu->store_buffer.entries;
+    if (cpu->store_wait)
+    {
+        return APEX_cpu_buffer_store(cpu, stage->pc, stage->memory_address);
+    }
+
+    if (cpu->store_buffer.entries
+        && APEX_store_buffer_holds(&cpu->store_buffer, stage->memory_address,
+                                   cpu->clock))
+    {
+        cpu->stats.sb_forwarded++;
+        return 0;
+    }
+    return cpu->l1d.config.size
+               ? APEX_cpu_cache_access(cpu, stage->pc, stage->memory_address,
+                                       store)
+               : 0;
+}
+
+/*
+ * Loads or stores the data memory word of an instruction in memory. Returns
+ * TRUE instead if it misses in the data cache, or waits for store buffer
+ * space, it then waits in memory until memory_ready and is not looked up
+ * again.
+ */
+PIPELINE_STAGE int
+memory_op(APEX_CPU *cpu, CPU_Stage *stage, const APEX_Opcode *op,
+          const int forwarding)
+{
+    int cycles;
+
+    if ((cpu->l1d.config.size | cpu->store_buffer.entries)
+        && (op->effects & (APEX_OP_LOAD | APEX_OP_STORE)))
+    {
+        if (!stage->stall
+            && (unsigned int)stage->memory_address
+                   < (unsigned int)cpu->data_memory.size)
+        {
+            cycles = memory_cycles(cpu, stage,
+                                   (op->effects & APEX_OP_STORE) != 0);
+            if (cycles)
+            {
+                stage->stall = 1;
+                cpu->memory_ready = cpu->clock + cycles;
+                return TRUE;
+            }
+        }
+        stage->stall = 0;
+    }
+
+    if (op->effects & APEX_OP_LOAD)
+    {
+        /* Read from data memory */
+        if (APEX_cpu_read(cpu, stage->memory_address, &stage->result_buffer))
+        {
+            APEX_memory_fault(cpu, stage->pc, stage->memory_address);
+        }
+
+        /* Loaded values are forwarded from the output of memory */
+        if (forwarding == APEX_FORWARD_FULL
+            && is_last_writer(cpu, stage, stage->rd))
+        {
+            cpu->reg_values[stage->rd] = stage->result_buffer;
+            cpu->regsStatus[stage->rd] = REG_FORWARDED;
+        }
+    }
+    else if (op->effects & APEX_OP_STORE)
+    {
+        /* Store data from source register rs2 to data memory */
+        if (APEX_cpu_write(cpu, stage->memory_address, stage->rs2_value))
+        {
+            APEX_memory_fault(cpu, stage->pc, stage->memory_address);
+        }
+    }
+
+    /* Without forwarding from memory, results computed in execute are not
+     * available again until writeback */
+    if (forwarding == APEX_FORWARD_EX)
+    {
+        forward_result(cpu, stage, op, REG_BUSY);
+    }
+    return FALSE;
+}
+
+/* Counts cycles memory is held, waiting for store buffer space or else on a
+ * data cache miss */
+PIPELINE_STAGE void
+count_memory_stall(APEX_CPU *cpu, const int cycles)
+{
+    if (cpu->store_wait)
+    {
+        cpu->stats.sb_stall_cycles += cycles;
+    }
+    else
+    {
+        cpu->stats.cache_stall_cycles += cycles;
+    }
+}
+
+/*
+ * Delays every stage before memory by the cycles a data cache miss holds
+ * memory: the groups in execute complete, and decode issues to each unit,
+ * that much later. Execute holds less than APEX_FU_MAX_LATENCY cycles of
+ * groups, so rotating it moves each one to its new clock.
+ */
+static void
+delay_pipeline(APEX_CPU *cpu, const int cycles)
+{
+    CPU_Stage execute[APEX_FU_MAX_LATENCY][APEX_MAX_WIDTH];
+    int i;
+
+    memcpy(execute, cpu->execute, sizeof(execute));
+    for (i = 0; i < APEX_FU_MAX_LATENCY; ++i)
+    {
+        memcpy(cpu->execute[(i + cycles) & APEX_FU_MASK], execute[i],
+               sizeof(execute[i]));
+    }
+    if (cpu->execute_done >= cpu->clock)
+    {
+        cpu->execute_done += cycles;
+    }
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        cpu->unit_ready[i] = (cpu->unit_ready[i] > cpu->clock
+                                  ? cpu->unit_ready[i]
+                                  : cpu->clock)
+                             + cycles;
+    }
+}
+
+/*
+ * Memory Stage of APEX Pipeline
+ *
+ * A load or store missing in the data cache holds memory, and every stage
+ * before it, until its line arrives, a store finding the store buffer full
+ * until it has space; the instructions ahead of it in its group move on.
+ * Returns TRUE while memory is held.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+PIPELINE_STAGE int
+APEX_memory(APEX_CPU *cpu, const int display, const int forwarding,
+            const int width)
+{
+    CPU_Stage *const stage = cpu->memory;
+    int i, j;
+
+    if (cpu->memory_ready > cpu->clock)
+    {
+        for (i = 0; display && i < width && stage[i].has_insn; ++i)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_MEMORY, i, stage[i].pc,
+                             TRUE);
+        }
+        count_memory_stall(cpu, 1);
+        return TRUE;
+    }
+
+    for (i = 0; i < width && stage[i].has_insn; ++i)
+    {
+        if (memory_op(cpu, &stage[i], &apex_isa[stage[i].opcode], forwarding))
+        {
+            for (j = i; display && j < width && stage[j].has_insn; ++j)
+            {
+                APEX_trace_stage(cpu->trace, APEX_TRACE_MEMORY, j,
+                                 stage[j].pc, TRUE);
+            }
+
+            /* The missing instruction moves up to the front of the group */
+            for (j = 0; i && j + i < width; ++j)
+            {
+                stage[j] = stage[j + i];
+                stage[j + i].has_insn = FALSE;
+            }
+            delay_pipeline(cpu, cpu->memory_ready - cpu->clock);
+            count_memory_stall(cpu, 1);
+            return TRUE;
+        }
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_MEMORY, i, stage[i].pc,
+                             stage[i].stall);
+        }
+
+        /* A faulting access stops the run, neither it nor the instructions
+         * after it retire */
+        if (cpu->halted)
+        {
+            break;
+        }
+
+        /* Copy data from memory latch to writeback latch*/
+        cpu->writeback[i] = stage[i];
+        stage[i].has_insn = FALSE;
+    }
+    return FALSE;
+}
+
+/*
+ * Shows the stages before a held memory, all stalled as well: the
+ * next group to complete execute, decode and a held fetch group
+ */
+static void
+trace_held(APEX_CPU *cpu, const int width)
+{
+    const CPU_Stage *group = oldest_in_execute(cpu);
+    int i;
+
+    for (i = 0; i < width; ++i)
+    {
+        if (group && group[i].has_insn)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_EXECUTE, i, group[i].pc,
+                             TRUE);
+        }
+        if (cpu->decode[i].has_insn)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_DECODE, i,
+                             cpu->decode[i].pc, TRUE);
+        }
+        if (cpu->fetch[0].stall && cpu->fetch[i].has_insn)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_FETCH, i,
+                             cpu->fetch[i].pc, TRUE);
+        }
+    }
+}
+
+/*
+ * Jumps the clock over the cycles a data cache miss, or a wait for store
+ * buffer space, still holds memory, once nothing is left to retire, up to
+ * the cycle limit
+ */
+static void
+skip_miss_cycles(APEX_CPU *cpu)
+{
+    long long until = cpu->memory_ready;
+
+    if (cpu->cycle > cpu->clock && cpu->cycle < until)
+    {
+        until = cpu->cycle;
+    }
+    count_memory_stall(cpu, until - cpu->clock - 1);
+    cpu->clock = until - 1;
+}
+
+/* Writes the results of an instruction to the register file, a loaded rd
+ * over its rs1 last. A register is valid again once its youngest writer in
+ * flight is written back. */
+PIPELINE_STAGE void
+writeback_op(APEX_CPU *cpu, const CPU_Stage *stage, const APEX_Opcode *op)
+{
+    if (op->effects & APEX_OP_RS1_INC)
+    {
+        cpu->regs[stage->rs1] = stage->rs1_value;
+        if (is_last_writer(cpu, stage, stage->rs1))
+        {
+            cpu->regsStatus[stage->rs1] = REG_VALID;
+        }
+    }
+    if (op->effects & APEX_OP_RD)
+    {
+        cpu->regs[stage->rd] = stage->result_buffer;
+        if (is_last_writer(cpu, stage, stage->rd))
+        {
+            cpu->regsStatus[stage->rd] = REG_VALID;
+        }
+    }
+}
+
+/*
+ * Writeback Stage of APEX Pipeline
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+PIPELINE_STAGE int
+APEX_writeback(APEX_CPU *cpu, const int display, const int width)
+{
+    CPU_Stage *const stage = cpu->writeback;
+    int i, stop = FALSE;
+
+    for (i = 0; i < width && stage[i].has_insn; ++i)
+    {
+        writeback_op(cpu, &stage[i], &apex_isa[stage[i].opcode]);
+
+        cpu->insn_completed++;
+        cpu->stats.retired[stage[i].opcode]++;
+        stage[i].has_insn = FALSE;
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_WRITEBACK, i, stage[i].pc,
+                             stage[i].stall);
+        }
+
+        if (stage[i].opcode == OPCODE_HALT)
+        {
+            /* Stop the APEX simulator */
+            cpu->halted = TRUE;
+            return TRUE;
+        }
+
+        /* End of a detailed window of a sampled run, the rest of the group
+         * retires with it */
+        if (cpu->insn_completed == cpu->insn_limit)
+        {
+            stop = TRUE;
+        }
+    }
+
+    /* Default */
+    return stop;
+}
+
+/*
+ * Resumes a CPU from a checkpoint file. Its cycle (or, run functionally or
+ * sampled, instruction) limit counts from the checkpoint on. Returns 0 on success.
+ */
+static int
+resume_checkpoint(APEX_CPU *cpu, const char *filename,
+                  const int data_memory_size)
+{
+    if (APEX_checkpoint_load(cpu, filename))
+    {
+        return -1;
+    }
+
+    if (data_memory_size && data_memory_size != cpu->data_memory.size)
+    {
+        fprintf(stderr, "APEX_Error: %s has %d words of data memory\n",
+                filename, cpu->data_memory.size);
+        return -1;
+    }
+
+    if (cpu->functional || cpu->sampled)
+    {
+        if (cpu->functional && (cpu->decode[0].has_insn
+            || oldest_in_execute(cpu) || cpu->memory[0].has_insn
+            || cpu->writeback[0].has_insn || cpu->ooo.rob_count))
+        {
+            fprintf(stderr, "APEX_Error: %s has instructions in flight, "
+                            "resume it in the pipeline\n", filename);
+            return -1;
+        }
+        cpu->cycle = cpu->cycle > 0 ? cpu->insn_completed + cpu->cycle : 0;
+    }
+    else
+    {
+        cpu->cycle += cpu->clock;
+    }
+    return 0;
+}
+
+/*
+ * This function creates and initializes APEX cpu with data_memory_size words
+ * of data memory (DATA_MEMORY_SIZE if 0), or resumes it from a checkpoint file.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+APEX_CPU *
+APEX_cpu_init(const char *filename, const char* fun, const long long n,
+              const int data_memory_size)
+{
+    int i;
+    APEX_CPU *cpu;
+
+    if (!filename && !fun && !n)
+    {
+        return NULL;
+    }
+
+    cpu = calloc(1, sizeof(APEX_CPU));
+    if (!cpu)
+    {
+        return NULL;
+    }
+
+    cpu->functional = strcmp(fun,"functional") == 0 ? 1 : 0;
+    cpu->sampled = strcmp(fun,"sample") == 0 ? 1 : 0;
+    cpu->simulate = (strcmp(fun,"simulate") == 0 || strcmp(fun,"trace") == 0
+                     || cpu->functional || cpu->sampled) ? 0 :1;
+    cpu->cycle = n;
+
+    /* Initialize PC, Registers and all pipeline stages */
+    cpu->pc = 4000;
+    memset(cpu->regs, 0, sizeof(int) * REG_FILE_SIZE);
+    cpu->single_step = strcmp(fun,"single_step") == 0 ? ENABLE_SINGLE_STEP : 0;
+    cpu->forwarding = APEX_DEFAULT_FORWARDING;
+    cpu->width = 1;
+
+    /* To start fetch stage */
+    cpu->fetch[0].has_insn = TRUE;
+
+    /* Every unit completes an operation in one cycle unless configured */
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        cpu->units[i].latency = 1;
+        cpu->units[i].pipelined = TRUE;
+    }
+    APEX_predictor_init(&cpu->predictor, APEX_BP_NONE, APEX_BP_COUNTERS,
+                        APEX_BP_BTB);
+    cpu->core = APEX_CORE_INORDER;
+    APEX_ooo_init(&cpu->ooo, APEX_OOO_ROB, APEX_OOO_IQ, APEX_OOO_LSQ,
+                  APEX_OOO_PRF);
+
+    /* Memory answers every access in memory's or fetch's cycle unless caches
+     * are configured, fetch reads any number of instructions a cycle */
+    cpu->l1i.latency = 1;
+    cpu->l1d.latency = 1;
+    cpu->l2.latency = APEX_CACHE_L2_LATENCY;
+    cpu->dram_latency = APEX_CACHE_DRAM_LATENCY;
+    cpu->fetch_mask = -1;
+    APEX_prefetcher_init(&cpu->prefetcher, APEX_PREFETCH_NONE, 0, 0);
+    APEX_store_buffer_init(&cpu->store_buffer, 0, 0);
+
+    if (APEX_checkpoint_probe(filename))
+    {
+        if (resume_checkpoint(cpu, filename, data_memory_size))
+        {
+            APEX_image_unload(cpu);
+            APEX_memory_free(&cpu->data_memory);
+            APEX_cache_free(&cpu->l1i);
+            APEX_cache_free(&cpu->l1d);
+            APEX_cache_free(&cpu->l2);
+            free(cpu);
+            return NULL;
+        }
+    }
+    else if (APEX_memory_init(&cpu->data_memory, data_memory_size
+                                                 ? data_memory_size
+                                                 : DATA_MEMORY_SIZE))
+    {
+        free(cpu);
+        return NULL;
+    }
+    /* Map a pre-assembled image, or parse input file and create code memory */
+    else if (APEX_image_probe(filename))
+    {
+        if (APEX_image_load(cpu, filename))
+        {
+            APEX_memory_free(&cpu->data_memory);
+            free(cpu);
+            return NULL;
+        }
+    }
+    else
+    {
+        cpu->code_memory = create_code_memory(filename, &cpu->code_memory_size);
+        if (!cpu->code_memory)
+        {
+            APEX_memory_free(&cpu->data_memory);
+            free(cpu);
+            return NULL;
+        }
+    }
+
+    if (ENABLE_DEBUG_MESSAGES & cpu->simulate)
+    {
+        fprintf(stderr,
+                "APEX_CPU: Initialized APEX CPU, loaded %d instructions\n",
+                cpu->code_memory_size);
+        fprintf(stderr, "APEX_CPU: PC initialized to %d\n", cpu->pc);
+        fprintf(stderr, "APEX_CPU: Printing Code Memory\n");
+        printf("%-9s %-9s %-9s %-9s %-9s\n", "opcode_str", "rd", "rs1", "rs2",
+               "imm");
+
+        for (i = 0; i < cpu->code_memory_size; ++i)
+        {
+            printf("%-9s %-9d %-9d %-9d %-9d\n",
+                   get_opcode_str(cpu->code_memory[i].opcode),
+                   cpu->code_memory[i].rd, cpu->code_memory[i].rs1,
+                   cpu->code_memory[i].rs2, cpu->code_memory[i].imm);
+        }
+
+        cpu->trace = APEX_trace_open(NULL, APEX_TRACE_TEXT, cpu->width,
+                                     cpu->code_memory, cpu->code_memory_size);
+        if (!cpu->trace)
+        {
+            APEX_image_unload(cpu);
+            APEX_memory_free(&cpu->data_memory);
+            APEX_cache_free(&cpu->l1i);
+            APEX_cache_free(&cpu->l1d);
+            APEX_cache_free(&cpu->l2);
+            free(cpu);
+            return NULL;
+        }
+    }
+
+    return cpu;
+}
+
+/*
+ * Returns TRUE if no latch can change next cycle: no instruction completes
+ * execute, nothing is in flight after it and both decode and fetch are held.
+ * Every following cycle is then the same as this one until a unit completes
+ * an instruction or takes the one in decode, and only stall counters move.
+ */
+PIPELINE_STAGE int
+pipeline_frozen(const APEX_CPU *cpu)
+{
+    return !cpu->writeback[0].has_insn && !cpu->memory[0].has_insn
+           && !cpu->execute[(cpu->clock + 1) & APEX_FU_MASK][0].has_insn
+           && !cpu->fetch_from_next_cycle
+           && (cpu->decode[0].has_insn ? cpu->decode[0].stall
+                                       : !cpu->fetch[0].stall)
+           && (!cpu->fetch[0].has_insn || cpu->fetch[0].stall);
+}
+
+/*
+ * Jumps the clock over the cycles after a frozen one, up to the next cycle
+ * that can change a latch or the cycle limit, and counts the stalls those
+ * cycles would have counted. A frozen pipeline with neither is deadlocked.
+ */
+static void
+skip_frozen_cycles(APEX_CPU *cpu)
+{
+    long long until = LLONG_MAX, clock, issue, skipped;
+    int structural = FALSE;
+
+    /* The next instruction to complete execute */
+    for (clock = cpu->clock + 2; clock <= cpu->execute_done; ++clock)
+    {
+        if (cpu->execute[clock & APEX_FU_MASK][0].has_insn)
+        {
+            until = clock;
+            break;
+        }
+    }
+
+    /* Decode held by a unit this cycle issues once the unit can take it */
+    if (cpu->decode[0].has_insn
+        && (issue = issue_clock(cpu, &cpu->decode[0])) > cpu->clock)
+    {
+        structural = TRUE;
+        until = issue < until ? issue : until;
+    }
+
+    if (cpu->cycle > cpu->clock && cpu->cycle < until)
+    {
+        until = cpu->cycle;
+    }
+
+    if (until == LLONG_MAX)
+    {
+        if (!cpu->quiet)
+        {
+            fprintf(stderr, "APEX_Error: Pipeline deadlocked at cycle %lld\n",
+                    cpu->clock);
+        }
+        cpu->halted = TRUE;
+        return;
+    }
+
+    skipped = until - cpu->clock - 1;
+    if (structural)
+    {
+        cpu->stats.structural_stall_cycles += skipped;
+    }
+    else if (cpu->decode[0].has_insn)
+    {
+        cpu->stats.raw_stall_cycles += skipped;
+    }
+    cpu->stats.fetch_stall_cycles += cpu->fetch[0].stall ? skipped : 0;
+    cpu->clock += skipped;
+}
+
+/*
+ * APEX CPU simulation loop, specialized on display, forwarding, width and the
+ * back end by its callers. The out-of-order back end replaces every stage but
+ * fetch. In order, a data cache miss in memory, or a store waiting for store
+ * buffer space, holds the stages before it.
+ * Without display, runs of frozen in-order cycles, and of cycles held by a
+ * miss, cost one step, see pipeline_frozen.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+PIPELINE_STAGE void
+APEX_cpu_run_loop(APEX_CPU *cpu, const int display, const int forwarding,
+                  const int wide, const int ooo)
+{
+    const int width = wide ? cpu->width : 1;
+    char user_prompt_val;
+
+    /* Nothing renamed, the architectural state may have changed since */
+    if (ooo && !cpu->ooo.rob_count)
+    {
+        APEX_ooo_reset(cpu);
+    }
+
+    while (TRUE)
+    {
+        /* Instructions before a faulting access in memory last cycle still
+         * retire, it never reaches writeback */
+        if ((ooo ? APEX_ooo_writeback(cpu, display, width)
+                 : APEX_writeback(cpu, display, width))
+            || cpu->halted || cpu->clock == cpu->cycle)
+        {
+            if (display)
+            {
+                APEX_trace_end_cycle(cpu->trace, cpu->clock);
+                APEX_trace_flush(cpu->trace);
+            }
+
+            /* Halt in writeback stage, sampled runs report once at the end */
+            if (!cpu->quiet && !cpu->sampled)
+            {
+                printf("APEX_CPU: Simulation Complete, cycles = %lld instructions = %lld\n", cpu->clock, cpu->insn_completed);
+            }
+            break;
+        }
+
+        if (ooo)
+        {
+            APEX_ooo_complete(cpu, display, width);
+            APEX_ooo_issue(cpu, display, width);
+            APEX_ooo_rename(cpu, display, width);
+            APEX_fetch(cpu, display, width);
+        }
+        else if (!APEX_memory(cpu, display, forwarding, width))
+        {
+            APEX_execute(cpu, display, forwarding, width);
+            APEX_decode(cpu, display, forwarding, width);
+            APEX_fetch(cpu, display, width);
+        }
+        else if (display)
+        {
+            trace_held(cpu, width);
+        }
+        else if (!cpu->writeback[0].has_insn)
+        {
+            skip_miss_cycles(cpu);
+        }
+
+        if (display)
+        {
+            APEX_trace_end_cycle(cpu->trace, cpu->clock);
+        }
+
+        if (display && cpu->single_step)
+        {
+            APEX_trace_flush(cpu->trace);
+            print_reg_file(cpu);
+            printf("Press any key to advance CPU Clock or <q> to quit:\n");
+            scanf("%c", &user_prompt_val);
+
+            if ((user_prompt_val == 'Q') || (user_prompt_val == 'q'))
+            {
+                printf("APEX_CPU: Simulation Stopped, cycles = %lld instructions = %lld\n", cpu->clock, cpu->insn_completed);
+                break;
+            }
+        }
+
+        /* Without display no cycle has to be simulated to be shown */
+        if (!display && !ooo && pipeline_frozen(cpu))
+        {
+            skip_frozen_cycles(cpu);
+        }
+
+        cpu->clock++;
+    }
+}
+
+#define APEX_RUN_LOOP(name, display, forwarding, wide)                         \
+    static void __attribute__((noinline)) name(APEX_CPU *cpu)                  \
+    {                                                                          \
+        APEX_cpu_run_loop(cpu, display, forwarding, wide, FALSE);              \
+    }
+
+/* Forwarding does not apply out of order, completing results wake their
+ * dependents up */
+#define APEX_OOO_RUN_LOOP(name, display)                                       \
+    static void __attribute__((noinline)) name(APEX_CPU *cpu)                  \
+    {                                                                          \
+        APEX_cpu_run_loop(cpu, display, APEX_FORWARD_NONE, TRUE, TRUE);        \
+    }
+
+APEX_RUN_LOOP(APEX_cpu_run_display_none, TRUE, APEX_FORWARD_NONE, FALSE)
+APEX_RUN_LOOP(APEX_cpu_run_display_ex, TRUE, APEX_FORWARD_EX, FALSE)
+APEX_RUN_LOOP(APEX_cpu_run_display_full, TRUE, APEX_FORWARD_FULL, FALSE)
+APEX_RUN_LOOP(APEX_cpu_run_quiet_none, FALSE, APEX_FORWARD_NONE, FALSE)
+APEX_RUN_LOOP(APEX_cpu_run_quiet_ex, FALSE, APEX_FORWARD_EX, FALSE)
+APEX_RUN_LOOP(APEX_cpu_run_quiet_full, FALSE, APEX_FORWARD_FULL, FALSE)
+APEX_RUN_LOOP(APEX_cpu_run_display_wide_none, TRUE, APEX_FORWARD_NONE, TRUE)
+APEX_RUN_LOOP(APEX_cpu_run_display_wide_ex, TRUE, APEX_FORWARD_EX, TRUE)
+APEX_RUN_LOOP(APEX_cpu_run_display_wide_full, TRUE, APEX_FORWARD_FULL, TRUE)
+APEX_RUN_LOOP(APEX_cpu_run_quiet_wide_none, FALSE, APEX_FORWARD_NONE, TRUE)
+APEX_RUN_LOOP(APEX_cpu_run_quiet_wide_ex, FALSE, APEX_FORWARD_EX, TRUE)
+APEX_RUN_LOOP(APEX_cpu_run_quiet_wide_full, FALSE, APEX_FORWARD_FULL, TRUE)
+APEX_OOO_RUN_LOOP(APEX_cpu_run_quiet_ooo, FALSE)
+APEX_OOO_RUN_LOOP(APEX_cpu_run_display_ooo, TRUE)
+
+/*
+ * Runs the pipeline under cpu->core, cpu->forwarding and cpu->width, tracing
+ * every cycle in display, single_step and trace modes
+ */
+void
+APEX_cpu_run(APEX_CPU *cpu)
+{
+    static void (*const run_loops[2][2][3])(APEX_CPU *) = {
+        {{APEX_cpu_run_quiet_none, APEX_cpu_run_quiet_ex,
+          APEX_cpu_run_quiet_full},
+         {APEX_cpu_run_display_none, APEX_cpu_run_display_ex,
+          APEX_cpu_run_display_full}},
+        {{APEX_cpu_run_quiet_wide_none, APEX_cpu_run_quiet_wide_ex,
+          APEX_cpu_run_quiet_wide_full},
+         {APEX_cpu_run_display_wide_none, APEX_cpu_run_display_wide_ex,
+          APEX_cpu_run_display_wide_full}},
+    };
+
+    if (cpu->core == APEX_CORE_OOO)
+    {
+        (cpu->trace || cpu->single_step ? APEX_cpu_run_display_ooo
+                                        : APEX_cpu_run_quiet_ooo)(cpu);
+        return;
+    }
+
+    run_loops[cpu->width > 1][cpu->trace || cpu->single_step]
+             [cpu->forwarding](cpu);
+}
+
+/*
+ * Squashes the instructions in flight at the end of a run, leaving exactly
+ * the state of the retired instructions and the PC of the oldest squashed
+ * one, from which the pipeline or functional mode continue.
+ *
+ * Note: Only instructions past memory have written data memory, and they
+ * have retired when the run loop stops. Flags set in execute by a squashed
+ * instruction are set again when it runs again. Out of order, only committed
+ * instructions have written registers, flags or data memory.
+ */
+void
+APEX_cpu_flush(APEX_CPU *cpu)
+{
+    const CPU_Stage *oldest = oldest_in_execute(cpu);
+    int i, j;
+
+    if (cpu->ooo.rob_count)
+    {
+        cpu->pc = cpu->ooo.rob[cpu->ooo.rob_head].pc;
+    }
+    else if (cpu->memory[0].has_insn)
+    {
+        cpu->pc = cpu->memory[0].pc;
+    }
+    else if (oldest)
+    {
+        cpu->pc = oldest->pc;
+    }
+    else if (cpu->decode[0].has_insn)
+    {
+        cpu->pc = cpu->decode[0].pc;
+    }
+
+    for (i = 0; i < APEX_MAX_WIDTH; ++i)
+    {
+        cpu->memory[i].has_insn = FALSE;
+        for (j = 0; j < APEX_FU_MAX_LATENCY; ++j)
+        {
+            cpu->execute[j][i].has_insn = FALSE;
+        }
+        cpu->decode[i].has_insn = FALSE;
+    }
+    memset(cpu->unit_ready, 0, sizeof(cpu->unit_ready));
+    cpu->execute_done = 0;
+    cpu->execute_count = 0;
+    cpu->memory_ready = 0;
+    cpu->fetch_ready = 0;
+    cpu->decode[0].stall = FALSE;
+    cpu->fetch[0].stall = FALSE;
+    cpu->fetch[0].has_insn = !cpu->halted;
+    cpu->fetch_from_next_cycle = FALSE;
+    memset(cpu->regsStatus, 0, sizeof(cpu->regsStatus));
+    APEX_ooo_reset(cpu);
+}
+
+/*
+ * Reports a data memory access out of bounds and stops the run
+ */
+void
+APEX_memory_fault(APEX_CPU *cpu, int pc, int address)
+{
+    if (!cpu->quiet)
+    {
+        fprintf(stderr, "APEX_Error: Data memory address %d out of bounds "
+                        "at pc(%d)\n", address, pc);
+    }
+    cpu->fault = TRUE;
+    cpu->halted = TRUE;
+}
+
+/*
+ * Returns the forwarding policy named none, ex or full, or -1
+ */
+int
+APEX_forwarding_policy(const char *name)
+{
+    if (strcmp(name, "none") == 0)
+    {
+        return APEX_FORWARD_NONE;
+    }
+    if (strcmp(name, "ex") == 0)
+    {
+        return APEX_FORWARD_EX;
+    }
+    if (strcmp(name, "full") == 0)
+    {
+        return APEX_FORWARD_FULL;
+    }
+    return -1;
+}
+
+const char *
+APEX_forwarding_name(int forwarding)
+{
+    static const char *const names[] = {"none", "ex", "full"};
+
+    return names[forwarding];
+}
+
+/*
+ * Switches the forwarding policy of a CPU, possibly mid-run. Values published
+ * on the forwarding path are then read only after writeback, which is correct
+ * under any policy.
+ */
+void
+APEX_cpu_set_forwarding(APEX_CPU *cpu, int forwarding)
+{
+    int i;
+
+    if (forwarding == cpu->forwarding)
+    {
+        return;
+    }
+
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        if (cpu->regsStatus[i] == REG_FORWARDED)
+        {
+            cpu->regsStatus[i] = REG_BUSY;
+        }
+    }
+    cpu->forwarding = forwarding;
+}
+
+const char *
+APEX_unit_name(int unit)
+{
+    static const char *const names[] = {"alu", "mul", "div", "agu"};
+
+    return names[unit];
+}
+
+/*
+ * Sets the timing of the units given a latency, possibly mid-run. Operations
+ * already in execute complete when they were issued to, later ones with the
+ * last issued group while it has room, else after it, as in issue.
+ */
+void
+APEX_cpu_set_units(APEX_CPU *cpu, const APEX_Unit *units)
+{
+    const int full = cpu->execute_count >= cpu->width;
+    long long ready;
+    int i;
+
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        if (units[i].latency)
+        {
+            cpu->units[i] = units[i];
+        }
+        ready = cpu->execute_done - cpu->units[i].latency + full;
+        if (cpu->unit_ready[i] < ready)
+        {
+            cpu->unit_ready[i] = ready;
+        }
+    }
+}
+
+/*
+ * Sets the number of instructions fetched, decoded and issued per cycle,
+ * possibly mid-run. Narrowing squashes the instructions in flight, whose
+ * groups may not fit. Returns 0 on success.
+ */
+int
+APEX_cpu_set_width(APEX_CPU *cpu, int width)
+{
+    if (width < 1 || width > APEX_MAX_WIDTH)
+    {
+        fprintf(stderr, "APEX_Error: Width takes 1 to %d instructions per "
+                        "cycle\n", APEX_MAX_WIDTH);
+        return -1;
+    }
+
+    if (APEX_trace_set_width(cpu->trace, width))
+    {
+        return -1;
+    }
+
+    if (width < cpu->width)
+    {
+        APEX_cpu_flush(cpu);
+    }
+    cpu->width = width;
+    return 0;
+}
+
+/*
+ * Returns the back end named inorder or ooo, or -1
+ */
+int
+APEX_core_kind(const char *name)
+{
+    if (strcmp(name, "inorder") == 0)
+    {
+        return APEX_CORE_INORDER;
+    }
+    if (strcmp(name, "ooo") == 0)
+    {
+        return APEX_CORE_OOO;
+    }
+    return -1;
+}
+
+const char *
+APEX_core_name(int core)
+{
+    static const char *const names[] = {"inorder", "ooo"};
+
+    return names[core];
+}
+
+/*
+ * Switches the back end of a CPU and sizes the structures of the
+ * out-of-order one, possibly mid-run. Either change squashes the
+ * instructions in flight. Returns 0 on success.
+ */
+int
+APEX_cpu_set_core(APEX_CPU *cpu, int core, int rob_size, int iq_size,
+                  int lsq_size, int prf_size)
+{
+    const APEX_Ooo *ooo = &cpu->ooo;
+
+    if (rob_size != ooo->rob_size || iq_size != ooo->iq_size
+        || lsq_size != ooo->lsq_size || prf_size != ooo->prf_size)
+    {
+        if (ooo->rob_count)
+        {
+            APEX_cpu_flush(cpu);
+        }
+        if (APEX_ooo_init(&cpu->ooo, rob_size, iq_size, lsq_size, prf_size))
+        {
+            return -1;
+        }
+    }
+
+    if (core != cpu->core)
+    {
+        APEX_cpu_flush(cpu);
+        cpu->core = core;
+    }
+    return 0;
+}
+
+/*
+ * Resolves the cache option of a level against the CPU's cache: size 0
+ * keeps it, -1 removes it
+ */
+static APEX_Cache_Config
+cache_config(const APEX_Cache_Config *option, const APEX_Cache *cache)
+{
+    APEX_Cache_Config config = *option;
+
+    if (!option->size)
+    {
+        config = cache->config;
+    }
+    else if (option->size < 0)
+    {
+        memset(&config, 0, sizeof(config));
+    }
+    return config;
+}
+
+/* Returns TRUE if two cache levels have the same geometry and policy */
+static int
+same_config(const APEX_Cache_Config *a, const APEX_Cache_Config *b)
+{
+    return a->size == b->size && a->ways == b->ways && a->line == b->line
+           && a->policy == b->policy;
+}
+
+/*
+ * Sets the instructions fetch reads a cycle: up to the end of its aligned
+ * fetch block, and of its instruction cache line
+ */
+static void
+set_fetch_mask(APEX_CPU *cpu)
+{
+    int words = cpu->fetch_block / 4;
+
+    if (cpu->l1i.config.size && (!words || cpu->l1i.config.line / 4 < words))
+    {
+        words = cpu->l1i.config.line / 4;
+    }
+    cpu->fetch_mask = words ? words - 1 : -1;
+}
+
+/*
+ * Configures the caches and their latencies, possibly mid-run, see
+ * APEX_Options. A level given another geometry or policy starts empty, one
+ * given only another latency keeps its lines. L2 backs the L1 caches and
+ * needs one, with lines at least as long as theirs. Returns 0 on success.
+ */
+int
+APEX_cpu_set_caches(APEX_CPU *cpu, const APEX_Cache_Config *l1i,
+                    const APEX_Cache_Config *l1d,
+                    const APEX_Cache_Config *l2, int l2_latency,
+                    int dram_latency)
+{
+    const APEX_Cache_Config l1i_config = cache_config(l1i, &cpu->l1i);
+    const APEX_Cache_Config l1d_config = cache_config(l1d, &cpu->l1d);
+    const APEX_Cache_Config l2_config = cache_config(l2, &cpu->l2);
+
+    if (!l2_latency)
+    {
+        l2_latency = cpu->l2.latency;
+    }
+    if (!dram_latency)
+    {
+        dram_latency = cpu->dram_latency;
+    }
+
+    if (l2_config.size
+        && ((!l1i_config.size && !l1d_config.size)
+            || l2_config.line < l1i_config.line
+            || l2_config.line < l1d_config.line))
+    {
+        fprintf(stderr, "APEX_Error: L2 needs an L1 cache, with lines no "
+                        "longer than its own\n");
+        return -1;
+    }
+    if (l2_latency > APEX_CACHE_MAX_LATENCY
+        || dram_latency > APEX_CACHE_MAX_LATENCY)
+    {
+        fprintf(stderr, "APEX_Error: L2 and DRAM latencies take at most %d "
+                        "cycles\n", APEX_CACHE_MAX_LATENCY);
+        return -1;
+    }
+
+    if (!same_config(&l1i_config, &cpu->l1i.config))
+    {
+        if (APEX_cache_init(&cpu->l1i, &l1i_config, 1))
+        {
+            return -1;
+        }
+        cpu->l1i.code = TRUE;
+        set_fetch_mask(cpu);
+    }
+    if ((!same_config(&l1d_config, &cpu->l1d.config)
+         && APEX_cache_init(&cpu->l1d, &l1d_config, 1))
+        || (!same_config(&l2_config, &cpu->l2.config)
+            && APEX_cache_init(&cpu->l2, &l2_config, l2_latency)))
+    {
+        return -1;
+    }
+    cpu->l2.latency = l2_latency;
+    cpu->dram_latency = dram_latency;
+    return 0;
+}
+
+/*
+ * Sets the aligned bytes fetch reads a cycle, 0 keeping the CPU's and -1
+ * lifting the limit, and the instruction prefetcher, -1 keeping the CPU's.
+ * Returns 0 on success.
+ */
+int
+APEX_cpu_set_fetch(APEX_CPU *cpu, int fetch_block, int iprefetch)
+{
+    if (fetch_block > 0
+        && (fetch_block < APEX_CACHE_MIN_LINE
+            || fetch_block > APEX_CACHE_MAX_LINE
+            || (fetch_block & (fetch_block - 1))))
+    {
+        fprintf(stderr, "APEX_Error: Fetch blocks take a power of 2 of %d to "
+                        "%d bytes\n", APEX_CACHE_MIN_LINE,
+                APEX_CACHE_MAX_LINE);
+        return -1;
+    }
+
+    if (fetch_block)
+    {
+        cpu->fetch_block = fetch_block > 0 ? fetch_block : 0;
+    }
+    if (iprefetch >= 0)
+    {
+        cpu->iprefetch = iprefetch;
+    }
+    set_fetch_mask(cpu);
+    return 0;
+}
+
+void
+APEX_options_init(APEX_Options *options)
+{
+    options->forwarding = -1;
+    options->data_memory_size = 0;
+    options->checkpoint = NULL;
+    options->state = NULL;
+    options->sample_period = 10000;
+    options->sample_warmup = 1000;
+    options->sample_window = 1000;
+    memset(options->units, 0, sizeof(options->units));
+    options->predictor = -1;
+    options->bp_counters = 0;
+    options->bp_btb = 0;
+    options->width = 0;
+    options->core = -1;
+    options->rob_size = 0;
+    options->iq_size = 0;
+    options->lsq_size = 0;
+    options->prf_size = 0;
+    memset(&options->l1i, 0, sizeof(options->l1i));
+    memset(&options->l1d, 0, sizeof(options->l1d));
+    memset(&options->l2, 0, sizeof(options->l2));
+    options->l2_latency = 0;
+    options->dram_latency = 0;
+    options->fetch_block = 0;
+    options->iprefetch = -1;
+    options->dprefetch = -1;
+    options->pf_entries = 0;
+    options->pf_degree = 0;
+    options->sb_entries = 0;
+    options->sb_drain = 0;
+    options->coherence = -1;
+    options->c2c_latency = 0;
+    options->quantum = 0;
+    options->threads = 0;
+}
+
+/* Parses the value of a name=<count> option, returns -1 if it is not one */
+static int
+parse_count(const char *arg, const char *name, int *count)
+{
+    size_t len = strlen(name);
+    char *end;
+    long value;
+
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    {
+        return -1;
+    }
+
+    value = strtol(arg + len + 1, &end, 10);
+    if (end == arg + len + 1 || *end || value <= 0 || value > INT_MAX)
+    {
+        return -1;
+    }
+    *count = (int)value;
+    return 0;
+}
+
+/* Parses the value of a name=<count> option too wide for an int, such as a
+ * sample period in instructions */
+static int
+parse_long_count(const char *arg, const char *name, long long *count)
+{
+    size_t len = strlen(name);
+    char *end;
+    long long value;
+
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    {
+        return -1;
+    }
+
+    errno = 0;
+    value = strtoll(arg + len + 1, &end, 10);
+    if (end == arg + len + 1 || *end || errno == ERANGE || value <= 0)
+    {
+        return -1;
+    }
+    *count = value;
+    return 0;
+}
+
+/*
+ * Parses a <unit>=<latency>[p] option, alu=, mul=, div= or agu=, p for a
+ * pipelined unit. Returns -1 if it is not one.
+ */
+static int
+parse_unit(const char *arg, APEX_Unit *units)
+{
+    const char *value;
+    char *end;
+    long latency;
+    int i;
+
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        value = arg + strlen(APEX_unit_name(i));
+        if (strncmp(arg, APEX_unit_name(i), strlen(APEX_unit_name(i))) == 0
+            && *value == '=')
+        {
+            latency = strtol(value + 1, &end, 10);
+            units[i].pipelined = *end == 'p';
+            end += units[i].pipelined;
+            if (end == value + 1 || *end || latency < 1
+                || latency > APEX_FU_MAX_LATENCY)
+            {
+                return -1;
+            }
+            units[i].latency = (int)latency;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Parses a <level>=<bytes>:<ways>:<line bytes>[:<policy>] option, l1i=,
+ * l1d= or l2=, the policy lru (the default), fifo or random, or
+ * <level>=none.
+ * Returns -1 if it is not one.
+ */
+static int
+parse_cache(const char *arg, const char *name, APEX_Cache_Config *config)
+{
+    const size_t len = strlen(name);
+    const char *value = arg + len + 1;
+    long fields[3];
+    char *end;
+    int i;
+
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    {
+        return -1;
+    }
+
+    if (strcmp(value, "none") == 0)
+    {
+        config->size = -1;
+        return 0;
+    }
+
+    for (i = 0; i < 3; ++i)
+    {
+        fields[i] = strtol(value, &end, 10);
+        if (end == value || fields[i] <= 0 || fields[i] > INT_MAX
+            || (i < 2 && *end != ':'))
+        {
+            return -1;
+        }
+        value = end + 1;
+    }
+
+    config->policy = APEX_CACHE_LRU;
+    if (*end == ':')
+    {
+        config->policy = APEX_cache_policy(end + 1);
+    }
+    else if (*end)
+    {
+        return -1;
+    }
+    config->size = (int)fields[0];
+    config->ways = (int)fields[1];
+    config->line = (int)fields[2];
+    return config->policy < 0 ? -1 : 0;
+}
+
+/*
+ * Applies an optional run argument: a forwarding policy name, mem=<words>, the
+ * size of data memory, checkpoint=<file>, state=<file> of the final state,
+ * period=, warmup= or window=<instructions> of a sampled run, the timing of a
+ * unit, see parse_unit, bp=<predictor>, the number of its bht=<counters> and
+ * btb=<entries>, width=<instructions> per cycle, core=<back end>, the rob=,
+ * iq=, lsq=<entries> and prf=<registers> of the out-of-order one, the l1i=,
+ * l1d= and l2= caches, see parse_cache, the l2lat= and dram=<cycles> of a
+ * miss, the fetchblock=<bytes> fetch reads a cycle, or none, the
+ * iprefetch=<prefetcher> of the instruction cache, the dprefetch=<prefetcher>
+ * of the data cache with its pfentries=<entries> and pfdegree=<lines>, the
+ * sb=<entries> of the store buffer, or none, and the sbdrain=<cycles> of a
+ * store, or the coherence=<protocol> of a system, the c2c=<cycles> of its
+ * transfers and upgrades, the quantum=<cycles> its cores run between barriers
+ * and the threads=<n> they run on. Returns -1 if it is none of them.
+ */
+int
+APEX_parse_option(const char *arg, APEX_Options *options)
+{
+    if (parse_unit(arg, options->units) == 0
+        || parse_count(arg, "mem", &options->data_memory_size) == 0
+        || parse_long_count(arg, "period", &options->sample_period) == 0
+        || parse_long_count(arg, "warmup", &options->sample_warmup) == 0
+        || parse_long_count(arg, "window", &options->sample_window) == 0
+        || parse_count(arg, "bht", &options->bp_counters) == 0
+        || parse_count(arg, "btb", &options->bp_btb) == 0
+        || parse_count(arg, "width", &options->width) == 0
+        || parse_count(arg, "rob", &options->rob_size) == 0
+        || parse_count(arg, "iq", &options->iq_size) == 0
+        || parse_count(arg, "lsq", &options->lsq_size) == 0
+        || parse_count(arg, "prf", &options->prf_size) == 0
+        || parse_count(arg, "l2lat", &options->l2_latency) == 0
+        || parse_count(arg, "dram", &options->dram_latency) == 0
+        || parse_count(arg, "fetchblock", &options->fetch_block) == 0
+        || parse_count(arg, "pfentries", &options->pf_entries) == 0
+        || parse_count(arg, "pfdegree", &options->pf_degree) == 0
+        || parse_count(arg, "sb", &options->sb_entries) == 0
+        || parse_count(arg, "sbdrain", &options->sb_drain) == 0
+        || parse_count(arg, "c2c", &options->c2c_latency) == 0
+        || parse_count(arg, "quantum", &options->quantum) == 0
+        || parse_count(arg, "threads", &options->threads) == 0
+        || parse_cache(arg, "l1i", &options->l1i) == 0
+        || parse_cache(arg, "l1d", &options->l1d) == 0
+        || parse_cache(arg, "l2", &options->l2) == 0)
+    {
+        return 0;
+    }
+
+    if (strcmp(arg, "fetchblock=none") == 0)
+    {
+        options->fetch_block = -1;
+        return 0;
+    }
+
+    if (strcmp(arg, "sb=none") == 0)
+    {
+        options->sb_entries = -1;
+        return 0;
+    }
+
+    /* Instruction fetch has no loads to find strides or streams in */
+    if (strncmp(arg, "iprefetch=", 10) == 0)
+    {
+        options->iprefetch = APEX_prefetcher_kind(arg + 10);
+        return options->iprefetch < 0
+                       || options->iprefetch > APEX_PREFETCH_NEXTLINE
+                   ? -1
+                   : 0;
+    }
+
+    if (strncmp(arg, "dprefetch=", 10) == 0)
+    {
+        options->dprefetch = APEX_prefetcher_kind(arg + 10);
+        return options->dprefetch < 0 ? -1 : 0;
+    }
+
+    if (strncmp(arg, "coherence=", 10) == 0)
+    {
+        options->coherence = APEX_coherence_protocol(arg + 10);
+        return options->coherence < 0 ? -1 : 0;
+    }
+
+    if (strncmp(arg, "checkpoint=", 11) == 0 && arg[11])
+    {
+        options->checkpoint = arg + 11;
+        return 0;
+    }
+
+    if (strncmp(arg, "state=", 6) == 0 && arg[6])
+    {
+        options->state = arg + 6;
+        return 0;
+    }
+
+    if (strncmp(arg, "bp=", 3) == 0)
+    {
+        options->predictor = APEX_predictor_kind(arg + 3);
+        return options->predictor < 0 ? -1 : 0;
+    }
+
+    if (strncmp(arg, "core=", 5) == 0)
+    {
+        options->core = APEX_core_kind(arg + 5);
+        return options->core < 0 ? -1 : 0;
+    }
+
+    options->forwarding = APEX_forwarding_policy(arg);
+    return options->forwarding < 0 ? -1 : 0;
+}
+
+/*
+ * Applies the forwarding policy, unit timing, branch predictor, width, back
+ * end, caches, fetch block, prefetchers and store buffer of run options to a
+ * CPU, possibly mid-run. A predictor or prefetcher given another kind or size
+ * starts untrained, a store buffer given another size or drain starts empty.
+ * Returns 0 on success.
+ */
+int
+APEX_cpu_set_options(APEX_CPU *cpu, const APEX_Options *options)
+{
+    const APEX_Predictor *bp = &cpu->predictor;
+    const APEX_Prefetcher *pf = &cpu->prefetcher;
+    const APEX_Store_Buffer *sb = &cpu->store_buffer;
+    const APEX_Ooo *ooo = &cpu->ooo;
+    int kind, num_counters, btb_size, entries, degree, drain;
+
+    if (options->forwarding >= 0)
+    {
+        APEX_cpu_set_forwarding(cpu, options->forwarding);
+    }
+    APEX_cpu_set_units(cpu, options->units);
+    if (options->width && APEX_cpu_set_width(cpu, options->width))
+    {
+        return -1;
+    }
+    if (APEX_cpu_set_core(
+            cpu, options->core >= 0 ? options->core : cpu->core,
+            options->rob_size ? options->rob_size : ooo->rob_size,
+            options->iq_size ? options->iq_size : ooo->iq_size,
+            options->lsq_size ? options->lsq_size : ooo->lsq_size,
+            options->prf_size ? options->prf_size : ooo->prf_size))
+    {
+        return -1;
+    }
+    if (APEX_cpu_set_caches(cpu, &options->l1i, &options->l1d, &options->l2,
+                            options->l2_latency, options->dram_latency)
+        || APEX_cpu_set_fetch(cpu, options->fetch_block, options->iprefetch))
+    {
+        return -1;
+    }
+
+    /* Another kind of prefetcher takes its own default table size */
+    kind = options->dprefetch >= 0 ? options->dprefetch : pf->kind;
+    entries = options->pf_entries ? options->pf_entries
+              : kind == pf->kind  ? pf->entries
+                                  : 0;
+    degree = options->pf_degree ? options->pf_degree : pf->degree;
+    if ((kind != pf->kind || entries != pf->entries || degree != pf->degree)
+        && APEX_prefetcher_init(&cpu->prefetcher, kind, entries, degree))
+    {
+        return -1;
+    }
+
+    entries = options->sb_entries > 0    ? options->sb_entries
+              : options->sb_entries == 0 ? sb->entries
+                                         : 0;
+    drain = options->sb_drain ? options->sb_drain : sb->drain;
+    if ((entries != sb->entries || drain != sb->drain)
+        && APEX_store_buffer_init(&cpu->store_buffer, entries, drain))
+    {
+        return -1;
+    }
+
+    kind = options->predictor >= 0 ? options->predictor : bp->kind;
+    num_counters = options->bp_counters ? options->bp_counters
+                                        : bp->num_counters;
+    btb_size = options->bp_btb ? options->bp_btb : bp->btb_size;
+    if (kind != bp->kind || num_counters != bp->num_counters
+        || btb_size != bp->btb_size)
+    {
+        return APEX_predictor_init(&cpu->predictor, kind, num_counters,
+                                   btb_size);
+    }
+    return 0;
+}
+
+static void
+print_regstate(APEX_CPU *cpu){
+
+    printf("\n");
+
+    printf("-------------------------------------------\n%s\n-------------------------------------------\n", "STATE OF ARCHITECTURAL REGISTER FILE:");
+    for (int i = 0; i < REG_FILE_SIZE ; ++i)
+    {
+        char status[10];
+        if(cpu->regsStatus[i]){
+            strcpy(status,"invalid");
+        }
+        else{
+             strcpy(status,"valid");
+        }
+        printf("|\tR[%d]\t|\tValue=%d \t\t|\tstatus=%s\n", i, cpu->regs[i], status);
+    }
+
+    printf("\n");
+
+}
+
+static void
+print_mem(APEX_CPU *cpu){
+
+    printf("\n");
+
+    printf("-------------------------------------------\n%s\n-------------------------------------------\n", " STATE OF DATA MEMORY:");
+    for (int i = 0; i < 10 && i < cpu->data_memory.size; ++i)
+    {
+        int value = 0;
+
+        APEX_memory_read(&cpu->data_memory, i, &value);
+        printf("|\tMEM[%d]\t|\tData Value=%d\n", i, value);
+    }
+
+    printf("\n");
+
+}
+
+/*
+ * Writes the architectural state of a CPU to a file: its registers, its flags
+ * and every non-zero word of data memory, one per line. Runs of a program
+ * reaching the same state write the same file, whatever mode ran them.
+ * Returns 0 on success.
+ */
+int
+APEX_cpu_save_state(const APEX_CPU *cpu, const char *filename)
+{
+    FILE *fp = fopen(filename, "w");
+    int i, j;
+
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create %s\n", filename);
+        return -1;
+    }
+
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        fprintf(fp, "R%d %d\n", i, cpu->regs[i]);
+    }
+    fprintf(fp, "Z %d\nP %d\n", cpu->zero_flag, cpu->pos_flag);
+
+    /* Pages never written are all zero */
+    for (i = 0; i < cpu->data_memory.num_pages; ++i)
+    {
+        const APEX_Page *page = cpu->data_memory.pages[i];
+
+        for (j = 0; page && j < APEX_PAGE_WORDS; ++j)
+        {
+            if (page->words[j])
+            {
+                fprintf(fp, "MEM[%d] %d\n", i * APEX_PAGE_WORDS + j,
+                        page->words[j]);
+            }
+        }
+    }
+
+    if (fclose(fp))
+    {
+        fprintf(stderr, "APEX_Error: Unable to write %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Writes the geometry and counters of a cache level as a JSON member,
+ * followed by those of its prefetcher unless that is -1: the share of its
+ * prefetches hit (accuracy), of the misses without it they removed
+ * (coverage) and of the hit ones that had arrived (timeliness)
+ */
+static void
+print_cache(FILE *fp, const char *name, const APEX_Cache *cache,
+            int prefetcher)
+{
+    const long long accesses = cache->hits + cache->misses;
+
+    fprintf(fp, "\"%s\":{\"size\":%d,\"ways\":%d,\"line\":%d,"
+                "\"policy\":\"%s\",\"latency\":%d,\"hits\":%lld,"
+                "\"misses\":%lld,\"writebacks\":%lld,\"miss_rate\":%.4f",
+            name, cache->config.size, cache->config.ways, cache->config.line,
+            APEX_cache_policy_name(cache->config.policy), cache->latency,
+            cache->hits, cache->misses, cache->writebacks,
+            accesses ? (double)cache->misses / accesses : 0.0);
+    if (prefetcher >= 0)
+    {
+        fprintf(fp, ",\"prefetcher\":\"%s\",\"prefetches\":%lld,"
+                    "\"useful_prefetches\":%lld,\"late_prefetches\":%lld,"
+                    "\"accuracy\":%.4f,\"coverage\":%.4f,"
+                    "\"timeliness\":%.4f",
+                APEX_prefetcher_name(prefetcher), cache->prefetches,
+                cache->useful_prefetches, cache->late_prefetches,
+                cache->prefetches ? (double)cache->useful_prefetches
+                                        / cache->prefetches
+                                  : 0.0,
+                cache->useful_prefetches + cache->misses
+                    ? (double)cache->useful_prefetches
+                          / (cache->useful_prefetches + cache->misses)
+                    : 0.0,
+                cache->useful_prefetches
+                    ? 1.0 - (double)cache->late_prefetches
+                                / cache->useful_prefetches
+                    : 0.0);
+    }
+    fprintf(fp, "}");
+}
+
+/*
+ * Writes the performance counters of a pipeline run as a JSON object
+ */
+void
+APEX_stats_print(FILE *fp, const APEX_CPU *cpu)
+{
+    const APEX_Stats *stats = &cpu->stats;
+    double cpi = 0.0;
+    int i, first = TRUE;
+
+    if (cpu->insn_completed)
+    {
+        cpi = (double)cpu->clock / cpu->insn_completed;
+    }
+
+    fprintf(fp, "{\"cycles\":%lld,\"instructions\":%lld,\"cpi\":%.3f",
+            cpu->clock, cpu->insn_completed, cpi);
+    fprintf(fp, ",\"width\":%d,\"issued\":[", cpu->width);
+    for (i = 0; i < cpu->width; ++i)
+    {
+        fprintf(fp, "%s%lld", i ? "," : "", stats->issued[i]);
+    }
+    fprintf(fp, "]");
+    fprintf(fp, ",\"stall_cycles\":{\"raw\":%lld,\"structural\":%lld,"
+                "\"fetch\":%lld,\"branch_flush\":%lld}",
+            stats->raw_stall_cycles, stats->structural_stall_cycles,
+            stats->fetch_stall_cycles, stats->flush_bubble_cycles);
+    fprintf(fp, ",\"branch_flushes\":%lld,\"flushed_instructions\":%lld",
+            stats->branch_flushes, stats->flushed_insns);
+
+    fprintf(fp, ",\"units\":{");
+    for (i = 0; i < APEX_FU_COUNT; ++i)
+    {
+        fprintf(fp, "%s\"%s\":{\"latency\":%d,\"pipelined\":%s,"
+                    "\"ops\":%lld}",
+                i ? "," : "", APEX_unit_name(i), cpu->units[i].latency,
+                cpu->units[i].pipelined ? "true" : "false",
+                stats->unit_ops[i]);
+    }
+    fprintf(fp, "}");
+
+    fprintf(fp, ",\"branch_prediction\":{\"predictor\":\"%s\",\"bht\":%d,"
+                "\"btb\":%d,\"branches\":%lld,\"taken\":%lld,"
+                "\"mispredictions\":%lld,\"accuracy\":%.4f,"
+                "\"btb_lookups\":%lld,\"btb_hits\":%lld,"
+                "\"cycles_saved\":%lld}",
+            APEX_predictor_name(cpu->predictor.kind),
+            cpu->predictor.num_counters, cpu->predictor.btb_size,
+            stats->branches, stats->taken_branches, stats->mispredictions,
+            stats->branches ? 1.0 - (double)stats->mispredictions
+                                        / stats->branches
+                            : 1.0,
+            stats->btb_lookups, stats->btb_hits,
+            (stats->taken_branches - stats->mispredictions)
+                * APEX_BP_REDIRECT_CYCLES);
+
+    if (cpu->core == APEX_CORE_OOO)
+    {
+        fprintf(fp, ",\"ooo\":{\"rob\":%d,\"iq\":%d,\"lsq\":%d,\"prf\":%d,"
+                    "\"dispatch_stalls\":{\"rob\":%lld,\"iq\":%lld,"
+                    "\"lsq\":%lld,\"prf\":%lld},\"rob_occupancy\":%.2f,"
+                    "\"iq_occupancy\":%.2f,\"loads_forwarded\":%lld,"
+                    "\"load_wait_cycles\":%lld}",
+                cpu->ooo.rob_size, cpu->ooo.iq_size, cpu->ooo.lsq_size,
+                cpu->ooo.prf_size, stats->rob_stall_cycles,
+                stats->iq_stall_cycles, stats->lsq_stall_cycles,
+                stats->prf_stall_cycles,
+                cpu->clock ? (double)stats->rob_occupancy / cpu->clock : 0.0,
+                cpu->clock ? (double)stats->iq_occupancy / cpu->clock : 0.0,
+                stats->loads_forwarded, stats->load_wait_cycles);
+    }
+
+    if (cpu->l1i.config.size || cpu->l1d.config.size)
+    {
+        fprintf(fp, ",\"cache\":{");
+        if (cpu->l1i.config.size)
+        {
+            print_cache(fp, "l1i", &cpu->l1i, cpu->iprefetch);
+            fprintf(fp, cpu->l1d.config.size ? "," : "");
+        }
+        if (cpu->l1d.config.size)
+        {
+            print_cache(fp, "l1d", &cpu->l1d, cpu->prefetcher.kind);
+        }
+        if (cpu->l2.config.size)
+        {
+            fprintf(fp, ",");
+            print_cache(fp, "l2", &cpu->l2, -1);
+        }
+        fprintf(fp, ",\"dram_latency\":%d,\"stall_cycles\":%lld}",
+                cpu->dram_latency, stats->cache_stall_cycles);
+    }
+
+    if (cpu->store_buffer.entries)
+    {
+        fprintf(fp, ",\"store_buffer\":{\"entries\":%d,\"drain\":%d,"
+                    "\"forwarded\":%lld,\"full_stall_cycles\":%lld}",
+                cpu->store_buffer.entries, cpu->store_buffer.drain,
+                stats->sb_forwarded, stats->sb_stall_cycles);
+    }
+
+    if (cpu->system)
+    {
+        fprintf(fp, ",\"coherence\":{\"transfers\":%lld,"
+                    "\"upgrades\":%lld,\"invalidations\":%lld}",
+                stats->coherence_transfers, stats->coherence_upgrades,
+                stats->coherence_invalidations);
+    }
+
+    if (cpu->l1i.config.size || cpu->fetch_block)
+    {
+        fprintf(fp, ",\"fetch\":{\"block\":%d,\"starved_cycles\":%lld}",
+                cpu->fetch_block, stats->fetch_starved_cycles);
+    }
+
+    fprintf(fp, ",\"retired\":{");
+    for (i = 0; i < (int)(sizeof(stats->retired) / sizeof(stats->retired[0]));
+         ++i)
+    {
+        if (stats->retired[i])
+        {
+            fprintf(fp, "%s\"%s\":%lld", first ? "" : ",", get_opcode_str(i),
+                    stats->retired[i]);
+            first = FALSE;
+        }
+    }
+    fprintf(fp, "}}");
+}
+
+/*
+ * This function deallocates APEX CPU.
+ *
+ * Note: You are free to edit this function according to your implementation
+ */
+void
+APEX_cpu_stop(APEX_CPU *cpu)
+{
+    if(!cpu->single_step && !cpu->quiet){
+        print_regstate(cpu);
+        print_mem(cpu);
+    }
+    if (!cpu->functional && !cpu->sampled && !cpu->quiet)
+    {
+        fprintf(stderr, "APEX_Stats: ");
+        APEX_stats_print(stderr, cpu);
+        fprintf(stderr, "\n");
+    }
+    APEX_trace_close(cpu->trace);
+    APEX_image_unload(cpu);
+    APEX_memory_free(&cpu->data_memory);
+    APEX_cache_free(&cpu->l1i);
+    APEX_cache_free(&cpu->l1d);
+    APEX_cache_free(&cpu->l2);
+    free(cpu->predecoded);
+    free(cpu);
+}
\ No newline at end of file
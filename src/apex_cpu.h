@@ -0,0 +1,347 @@
+/*
+ * apex_cpu.h
+ * Contains APEX cpu pipeline declarations
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _APEX_CPU_H_
+#define _APEX_CPU_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "apex_cache.h"
+#include "apex_macros.h"
+#include "apex_memory.h"
+#include "apex_ooo.h"
+#include "apex_prefetch.h"
+#include "apex_predictor.h"
+#include "apex_store_buffer.h"
+
+/* Format of an APEX instruction, packed into 8 bytes. The mnemonic is looked
+ * up with get_opcode_str only when printing */
+typedef struct APEX_Instruction
+{
+    unsigned char opcode;
+    unsigned char rd;
+    unsigned char rs1;
+    unsigned char rs2;
+    int imm;
+} APEX_Instruction;
+
+/* Model of CPU stage latch, 32 bytes so the latches share few cache lines */
+typedef struct CPU_Stage
+{
+    int pc;
+    unsigned char opcode;
+    unsigned char rs1;
+    unsigned char rs2;
+    unsigned char rd;
+    int imm;
+    int rs1_value;
+    int rs2_value;
+    int result_buffer;
+    union
+    {
+        int memory_address;        /* Of a load or store */
+        int predicted_pc;          /* Of a branch, target fetch followed */
+    };
+    unsigned char has_insn;
+    unsigned char stall;
+    unsigned char predicted_taken; /* Set if fetch followed it to predicted_pc */
+    unsigned char tag;             /* Issue number, see reg_writers */
+} CPU_Stage;
+
+/* Timing of a functional unit of execute */
+typedef struct APEX_Unit
+{
+    int latency;   /* Cycles in execute, 1 to APEX_FU_MAX_LATENCY */
+    int pipelined; /* Takes an operation every cycle, else one at a time */
+} APEX_Unit;
+
+/* Performance counters of a pipeline run */
+typedef struct APEX_Stats
+{
+    long long raw_stall_cycles;        /* Decode held by a busy source */
+    long long structural_stall_cycles; /* Decode held by a busy unit, to
+                                          complete in order, or behind a
+                                          branch */
+    long long fetch_stall_cycles;      /* Fetch held by a stalled decode */
+    long long flush_bubble_cycles;     /* Fetch idle while redirected to a
+                                          target */
+    long long branch_flushes;          /* Redirects of fetch by
+                                          mispredictions */
+    long long flushed_insns;           /* Instructions squashed in decode by
+                                          them */
+    long long branches;                /* Branches and jumps resolved in
+                                          execute */
+    long long taken_branches;          /* Of them, taken */
+    long long mispredictions;          /* Of them, fetched past the wrong
+                                          way */
+    long long btb_lookups;             /* Branches and jumps fetched */
+    long long btb_hits;                /* Of them, found in the BTB */
+    long long issued[APEX_MAX_WIDTH];  /* Cycles issuing 1, 2...
+                                          instructions */
+    long long rob_stall_cycles;        /* Decode held by a full ROB
+                                          (core=ooo) */
+    long long iq_stall_cycles;         /* By a full IQ */
+    long long lsq_stall_cycles;        /* By a full LSQ */
+    long long prf_stall_cycles;        /* By too few free physical
+                                          registers */
+    long long loads_forwarded;         /* Loads given an older store's data */
+    long long load_wait_cycles;        /* Loads held by older stores'
+                                          addresses */
+    long long rob_occupancy;           /* ROB entries in use, summed over
+                                          cycles */
+    long long iq_occupancy;            /* IQ entries likewise */
+    long long cache_stall_cycles;      /* Pipeline held by data cache misses,
+                                          out of order commit held by store
+                                          misses */
+    long long fetch_starved_cycles;    /* Fetch waiting on instruction cache
+                                          misses */
+    long long sb_forwarded;            /* Loads given data by the store
+                                          buffer */
+    long long sb_stall_cycles;         /* Memory, or out of order commit,
+                                          held by a full store buffer */
+    long long coherence_transfers;     /* Data cache misses given the line by
+                                          another core, in a system */
+    long long coherence_upgrades;      /* Stores to a shared line */
+    long long coherence_invalidations; /* Lines invalidated by other cores'
+                                          stores */
+    long long unit_ops[APEX_FU_COUNT]; /* Instructions issued, by unit */
+    long long retired[256];            /* Instructions retired, by opcode */
+} APEX_Stats;
+
+/* Buffered pipeline trace, see apex_trace.c */
+typedef struct APEX_Trace APEX_Trace;
+
+/* Snapshot of a CPU, see apex_checkpoint.c */
+typedef struct APEX_Checkpoint APEX_Checkpoint;
+
+/* Core of a multi-core system, see apex_system.c */
+typedef struct APEX_System_Core APEX_System_Core;
+
+/* Options given after the arguments of a run, see APEX_parse_option */
+typedef struct APEX_Options
+{
+    int forwarding;       /* Forwarding policy, -1 keeps the CPU's */
+    int data_memory_size; /* Words of data memory, 0 for the default */
+    const char *checkpoint; /* File to save a checkpoint to after the run */
+    const char *state;    /* File to save the final state to after the run */
+    long long sample_period; /* Instructions from one sample to the next */
+    long long sample_warmup; /* Detailed instructions warming up a sample */
+    long long sample_window; /* Detailed instructions measured by a sample */
+    APEX_Unit units[APEX_FU_COUNT]; /* Latency 0 keeps the CPU's */
+    int predictor;        /* Branch predictor, -1 keeps the CPU's */
+    int bp_counters;      /* Counters of the predictor, 0 keeps the CPU's */
+    int bp_btb;           /* Entries of the BTB, 0 keeps the CPU's */
+    int width;            /* Pipeline width, 0 keeps the CPU's */
+    int core;             /* Back end, -1 keeps the CPU's */
+    int rob_size;         /* Out-of-order structures, 0 keeps the CPU's */
+    int iq_size;
+    int lsq_size;
+    int prf_size;
+    APEX_Cache_Config l1i; /* Caches, size 0 keeps the CPU's, -1 removes */
+    APEX_Cache_Config l1d; /* it */
+    APEX_Cache_Config l2;
+    int l2_latency;       /* Cycles, 0 keeps the CPU's */
+    int dram_latency;
+    int fetch_block;      /* Bytes, 0 keeps the CPU's, -1 removes it */
+    int iprefetch;        /* Instruction prefetcher, -1 keeps the CPU's */
+    int dprefetch;        /* Data prefetcher, -1 keeps the CPU's */
+    int pf_entries;       /* Its table or streams, 0 keeps the CPU's */
+    int pf_degree;        /* Lines it fetches ahead, 0 keeps the CPU's */
+    int sb_entries;       /* Store buffer, 0 keeps the CPU's, -1 removes it */
+    int sb_drain;         /* Cycles a store drains in, 0 keeps the CPU's */
+    int coherence;        /* Protocol of a system, -1 for the default */
+    int c2c_latency;      /* Cycles of a transfer or upgrade, 0 for the
+                             default */
+    int quantum;          /* Cycles the cores of a system run between
+                             barriers, 0 for the c2c latency */
+    int threads;          /* Host threads of a system, 0 for one per core
+                             up to the host's processors */
+} APEX_Options;
+
+/* Model of APEX CPU */
+typedef struct APEX_CPU
+{
+    int pc;                        /* Current program counter */
+    long long clock;               /* Clock cycles elapsed */
+    long long insn_completed;      /* Instructions retired */
+    int regs[REG_FILE_SIZE];       /* Integer register file */
+    int code_memory_size;          /* Number of instruction in the input file */
+    APEX_Instruction *code_memory; /* Code Memory */
+    void *image;                   /* Mapped program image holding code memory */
+    size_t image_size;
+    void *predecoded;              /* Code predecoded by functional mode */
+    int single_step;               /* Wait for user input after every cycle */
+    int zero_flag;                 /* {TRUE, FALSE} Used by BZ and BNZ to branch */
+    int pos_flag;                  /* {TRUE, FALSE} Used by BP and BNP to branch */
+    int fetch_from_next_cycle;
+
+    int regsStatus[REG_FILE_SIZE]; /* REG_VALID, REG_BUSY or REG_FORWARDED */
+    int reg_values[REG_FILE_SIZE]; /* Forwarded values, see regsStatus */
+    unsigned char reg_writers[REG_FILE_SIZE]; /* Tag of the youngest writer
+                                                 of each register issued, the
+                                                 only one setting its state */
+    unsigned char issue_tag;       /* Tag of the last instruction issued */
+    int forwarding;                /* APEX_FORWARD_NONE, _EX or _FULL */
+    int simulate;
+    int functional;                /* Run architecturally, without the pipeline */
+    int sampled;                   /* Sampled run, see apex_sample.c */
+    long long insn_limit;          /* Stop the pipeline at this many retired */
+    int quiet;                     /* Print nothing, results are read from here */
+    int halted;                    /* Stopped by HALT or a fault */
+    int fault;                     /* Stopped by an out of bounds access */
+    long long cycle;               /* Cycle, or instruction, limit of the run */
+    APEX_Trace *trace;             /* Display output or trace file, if any */
+
+    /* Pipeline stages, each a group of up to width instructions in program
+     * order, the first unused one without has_insn. Execute holds every
+     * instruction issued to a unit until it completes, in the group of the
+     * clock it completes in. fetch[0].has_insn is set while fetch runs. */
+    int width;                     /* Instructions per cycle, 1 to
+                                      APEX_MAX_WIDTH */
+    CPU_Stage fetch[APEX_MAX_WIDTH];
+    CPU_Stage decode[APEX_MAX_WIDTH];
+    CPU_Stage execute[APEX_FU_MAX_LATENCY][APEX_MAX_WIDTH];
+    CPU_Stage memory[APEX_MAX_WIDTH];
+    CPU_Stage writeback[APEX_MAX_WIDTH];
+
+    APEX_Unit units[APEX_FU_COUNT]; /* Indexed by APEX_FU_ALU etc. */
+    long long unit_ready[APEX_FU_COUNT]; /* First clock decode can issue to a
+                                            unit */
+    long long execute_done;        /* Clock the last issued one completes */
+    int execute_count;             /* Instructions completing then */
+
+    int core;                      /* APEX_CORE_INORDER or APEX_CORE_OOO */
+    APEX_Ooo ooo;                  /* Out-of-order back end, see apex_ooo.h */
+
+    APEX_Memory data_memory;       /* Paged data memory, see apex_memory.h */
+    int dram_latency;              /* Cycles of a miss in the last level */
+    long long memory_ready;        /* Clock a miss in memory gets its line */
+    int store_wait;                /* Set if memory waits on store buffer
+                                      space instead */
+    long long fetch_ready;         /* Clock a miss in fetch gets its line, 0
+                                      once fetch has it */
+    int fetch_block;               /* Aligned bytes fetched a cycle, 0 for
+                                      any */
+    int fetch_mask;                /* Instructions of the block fetch reads a
+                                      cycle, less one, or -1 for any */
+    int iprefetch;                 /* APEX_PREFETCH_NONE or _NEXTLINE */
+    APEX_Predictor predictor;      /* Branch predictor, see apex_predictor.h */
+    APEX_Prefetcher prefetcher;    /* Data prefetcher, see apex_prefetch.h */
+    APEX_Store_Buffer store_buffer; /* See apex_store_buffer.h */
+    APEX_System_Core *system;      /* Core of a system sharing data memory,
+                                      NULL if alone */
+
+    APEX_Stats stats;
+
+    /* Caches, see apex_cache.h */
+    APEX_Cache l1i;
+    APEX_Cache l1d;
+    APEX_Cache l2;
+} APEX_CPU;
+
+APEX_Instruction *create_code_memory(const char *filename, int *size);
+const char *get_opcode_str(int opcode);
+int APEX_instruction_valid(int opcode, int rd, int rs1, int rs2);
+APEX_CPU *APEX_cpu_init(const char *filename, const char* fun, long long n,
+                        int data_memory_size);
+void APEX_cpu_run(APEX_CPU *cpu);
+void APEX_cpu_stop(APEX_CPU *cpu);
+void APEX_stats_print(FILE *fp, const APEX_CPU *cpu);
+int APEX_forwarding_policy(const char *name);
+const char *APEX_forwarding_name(int forwarding);
+void APEX_cpu_set_forwarding(APEX_CPU *cpu, int forwarding);
+void APEX_cpu_set_units(APEX_CPU *cpu, const APEX_Unit *units);
+int APEX_cpu_set_width(APEX_CPU *cpu, int width);
+const char *APEX_unit_name(int unit);
+void APEX_options_init(APEX_Options *options);
+int APEX_parse_option(const char *arg, APEX_Options *options);
+int APEX_cpu_set_options(APEX_CPU *cpu, const APEX_Options *options);
+int APEX_cpu_save_state(const APEX_CPU *cpu, const char *filename);
+void APEX_memory_fault(APEX_CPU *cpu, int pc, int address);
+void APEX_cpu_redirect(APEX_CPU *cpu, int target);
+int APEX_core_kind(const char *name);
+const char *APEX_core_name(int core);
+int APEX_cpu_set_core(APEX_CPU *cpu, int core, int rob_size, int iq_size,
+                      int lsq_size, int prf_size);
+int APEX_cpu_set_caches(APEX_CPU *cpu, const APEX_Cache_Config *l1i,
+                        const APEX_Cache_Config *l1d,
+                        const APEX_Cache_Config *l2, int l2_latency,
+                        int dram_latency);
+int APEX_cpu_set_fetch(APEX_CPU *cpu, int fetch_block, int iprefetch);
+int APEX_cpu_cache_access(APEX_CPU *cpu, int pc, int address, int write);
+int APEX_cpu_buffer_store(APEX_CPU *cpu, int pc, int address);
+void APEX_ooo_reset(APEX_CPU *cpu);
+int APEX_ooo_writeback(APEX_CPU *cpu, int display, int width);
+void APEX_ooo_complete(APEX_CPU *cpu, int display, int width);
+void APEX_ooo_issue(APEX_CPU *cpu, int display, int width);
+void APEX_ooo_rename(APEX_CPU *cpu, int display, int width);
+void APEX_cpu_flush(APEX_CPU *cpu);
+void APEX_functional_run(APEX_CPU *cpu);
+int APEX_sample_run(APEX_CPU *cpu, long long period, long long warmup,
+                    long long window);
+APEX_Checkpoint *APEX_checkpoint_take(const APEX_CPU *cpu);
+int APEX_checkpoint_restore(APEX_CPU *cpu, const APEX_Checkpoint *checkpoint);
+void APEX_checkpoint_free(APEX_Checkpoint *checkpoint);
+int APEX_checkpoint_save(const APEX_Checkpoint *checkpoint,
+                         const char *filename);
+int APEX_checkpoint_probe(const char *filename);
+int APEX_checkpoint_load(APEX_CPU *cpu, const char *filename);
+int APEX_image_probe(const char *filename);
+int APEX_image_assemble(const char *filename, const char *data_file,
+                        const char *image_file);
+int APEX_image_load(APEX_CPU *cpu, const char *filename);
+void APEX_image_unload(APEX_CPU *cpu);
+APEX_Trace *APEX_trace_open(const char *filename, int format, int width,
+                            const APEX_Instruction *code_memory,
+                            int code_memory_size);
+int APEX_trace_set_width(APEX_Trace *trace, int width);
+void APEX_trace_stage(APEX_Trace *trace, int stage, int slot, int pc,
+                      int stall);
+void APEX_trace_end_cycle(APEX_Trace *trace, long long clock);
+void APEX_trace_flush(APEX_Trace *trace);
+void APEX_trace_close(APEX_Trace *trace);
+int APEX_trace_render(const char *trace_file, const char *output_file);
+int APEX_batch_run(const char *manifest, int num_workers,
+                   const char *results_file);
+int APEX_coherence_protocol(const char *name);
+const char *APEX_coherence_name(int protocol);
+int APEX_system_run(const char *system_file, long long cycles,
+                    const APEX_Options *options);
+int APEX_system_read(APEX_System_Core *core, int address, int *value);
+int APEX_system_write(APEX_System_Core *core, int address, int value);
+int APEX_system_cache_access(APEX_System_Core *core, int address, int write);
+
+/*
+ * Reads the data memory word at address for a load, from the memory the
+ * core shares in a system. Returns -1 if address is out of bounds.
+ */
+static inline int
+APEX_cpu_read(APEX_CPU *cpu, int address, int *value)
+{
+    if (__builtin_expect(cpu->system != NULL, 0))
+    {
+        return APEX_system_read(cpu->system, address, value);
+    }
+    return APEX_memory_read(&cpu->data_memory, address, value);
+}
+
+/*
+ * Writes value to the data memory word at address for a store, to the memory
+ * the core shares in a system. Returns -1 if address is out of bounds.
+ */
+static inline int
+APEX_cpu_write(APEX_CPU *cpu, int address, int value)
+{
+    if (__builtin_expect(cpu->system != NULL, 0))
+    {
+        return APEX_system_write(cpu->system, address, value);
+    }
+    return APEX_memory_write(&cpu->data_memory, address, value);
+}
+#endif
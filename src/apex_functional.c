@@ -0,0 +1,227 @@
+/*
+ * apex_functional.c
+ * Contains the fast functional (non-pipelined) execution mode of APEX cpu
+ *
+ * Code memory is predecoded once into a compact table whose entries carry the
+ * address of their handler, and instructions are then executed with threaded
+ * (computed goto) dispatch. There are no pipeline latches, hazards or cycles,
+ * only the architectural state: registers, flags and data memory.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "apex_cpu.h"
+#include "apex_isa.h"
+#include "apex_macros.h"
+
+/* Predecoded instruction */
+typedef struct APEX_Predecoded
+{
+    const void *handler; /* Label executing this instruction */
+    int rd;
+    int rs1;
+    int rs2;
+    int imm;
+    int target;          /* Code memory index of a PC relative branch target */
+} APEX_Predecoded;
+
+/* Converts a PC into code memory index, or returns size if it lies outside */
+static int
+get_predecoded_index_from_pc(const int pc, const int size)
+{
+    /* Below code memory, pc - 4000 would overflow near INT_MIN */
+    if (pc < 4000 || (pc - 4000) % 4 || (pc - 4000) / 4 >= size)
+    {
+        return size;
+    }
+    return (pc - 4000) / 4;
+}
+
+#define FUNCTIONAL_OP static inline __attribute__((always_inline))
+
+/*
+ * Executes a predecoded instruction with op its row of apex_isa, the same way
+ * execute, memory and writeback do: a loaded rd that is also rs1 is written
+ * last and any non-zero result sets pos_flag. Returns the next instruction,
+ * or NULL if its memory access faulted.
+ */
+FUNCTIONAL_OP APEX_Predecoded *
+execute_predecoded(APEX_CPU *cpu, APEX_Predecoded *code, const int size,
+                   APEX_Predecoded *ins, const APEX_Opcode *op)
+{
+    int *regs = cpu->regs;
+    const int effects = op->effects;
+    const int a = regs[ins->rs1];
+    const int b = (effects & APEX_OP_IMM) ? ins->imm : regs[ins->rs2];
+    const int result = apex_alu(op->alu, a, b);
+    const int rs1_value
+        = (effects & APEX_OP_RS1_INC) ? apex_alu(APEX_ALU_ADD, a, 4) : a;
+    int loaded = 0;
+
+    if ((effects & APEX_OP_LOAD)
+        && APEX_memory_read(&cpu->data_memory, result, &loaded))
+    {
+        return NULL;
+    }
+    if ((effects & APEX_OP_STORE)
+        && APEX_memory_write(&cpu->data_memory, result, regs[ins->rs2]))
+    {
+        return NULL;
+    }
+
+    if (op->cc == APEX_CC_RESULT)
+    {
+        cpu->zero_flag = result == 0;
+        cpu->pos_flag = result != 0;
+    }
+    else if (op->cc == APEX_CC_COMPARE)
+    {
+        cpu->zero_flag = rs1_value == regs[ins->rs2];
+        cpu->pos_flag = rs1_value > regs[ins->rs2];
+    }
+
+    if (effects & APEX_OP_RS1_INC)
+    {
+        regs[ins->rs1] = rs1_value;
+    }
+    if (effects & APEX_OP_RD)
+    {
+        regs[ins->rd] = (effects & APEX_OP_LOAD) ? loaded : result;
+    }
+
+    if (op->branch == APEX_BRANCH_NEVER
+        || !apex_branch_taken(op->branch, cpu->zero_flag, cpu->pos_flag))
+    {
+        return ins + 1;
+    }
+    if (effects & APEX_OP_RS1)
+    {
+        return &code[get_predecoded_index_from_pc(
+            apex_alu(APEX_ALU_ADD, a, ins->imm), size)];
+    }
+    return &code[ins->target];
+}
+
+/* Address of a load or store, computed the same way as in execute */
+#define ADDRESS() apex_alu(APEX_ALU_ADD, regs[ins->rs1], ins->imm)
+
+#define DISPATCH()                                                             \
+    do                                                                         \
+    {                                                                          \
+        if (insn_completed == limit)                                           \
+        {                                                                      \
+            goto done;                                                         \
+        }                                                                      \
+        insn_completed++;                                                      \
+        goto *ins->handler;                                                    \
+    } while (0)
+
+/*
+ * One handler per row of APEX_ISA, each inlining execute_predecoded with its
+ * row as a constant. HALT stops the run instead.
+ */
+#define FUNCTIONAL_HANDLER(opcode, ...) [opcode] = &&op_##opcode,
+
+#define FUNCTIONAL_CASE(opcode, ...)                                           \
+    op_##opcode:                                                               \
+    if (opcode == OPCODE_HALT)                                                 \
+    {                                                                          \
+        goto halt;                                                             \
+    }                                                                          \
+    next = execute_predecoded(cpu, code, size, ins, &apex_isa[opcode]);        \
+    if (!next)                                                                 \
+    {                                                                          \
+        goto fault;                                                            \
+    }                                                                          \
+    ins = next;                                                                \
+    DISPATCH();
+
+/*
+ * Executes the program in code memory architecturally, stopping on HALT, when
+ * control leaves code memory or after cpu->cycle instructions (no limit if it
+ * is not positive).
+ *
+ * Note: Semantics match the pipelined model, so both produce the same final
+ * register and data memory state.
+ */
+void
+APEX_functional_run(APEX_CPU *cpu)
+{
+    static const void *handlers[256] = { APEX_ISA(FUNCTIONAL_HANDLER) };
+    const int size = cpu->code_memory_size;
+    const long long limit = cpu->cycle > 0 ? cpu->cycle : LLONG_MAX;
+    long long insn_completed = cpu->insn_completed;
+    const int *regs = cpu->regs;
+    APEX_Predecoded *code;
+    APEX_Predecoded *ins;
+    APEX_Predecoded *next;
+    int i;
+
+    /* Code is predecoded on the first run and kept for later ones, as a
+     * sampled run switches in and out of functional mode many times. One
+     * extra entry past the end catches control leaving code memory */
+    code = cpu->predecoded;
+    if (!code)
+    {
+        code = calloc(size + 1, sizeof(APEX_Predecoded));
+        if (!code)
+        {
+            fprintf(stderr, "APEX_Error: Unable to allocate predecoded code\n");
+            return;
+        }
+
+        for (i = 0; i < size; ++i)
+        {
+            const APEX_Instruction *src = &cpu->code_memory[i];
+
+            /* Undefined opcodes execute like NOP, as in the pipeline */
+            code[i].handler = handlers[src->opcode & 0xff];
+            if (!code[i].handler)
+            {
+                code[i].handler = handlers[OPCODE_NOP];
+            }
+            code[i].rd = src->rd;
+            code[i].rs1 = src->rs1;
+            code[i].rs2 = src->rs2;
+            code[i].imm = src->imm;
+            code[i].target
+                = get_predecoded_index_from_pc(4000 + 4 * i + src->imm, size);
+        }
+        code[size].handler = &&op_end;
+        cpu->predecoded = code;
+    }
+
+    /* A halted CPU, resumed from a checkpoint, has nothing left to run */
+    ins = &code[get_predecoded_index_from_pc(cpu->pc, size)];
+    if (cpu->halted)
+    {
+        goto done;
+    }
+    DISPATCH();
+
+    APEX_ISA(FUNCTIONAL_CASE)
+
+fault:
+    /* The faulting access did not complete */
+    insn_completed--;
+    APEX_memory_fault(cpu, 4000 + 4 * (int)(ins - code), ADDRESS());
+    goto done;
+
+op_end:
+    /* Control left code memory, this was not an instruction */
+    insn_completed--;
+
+halt:
+    cpu->halted = TRUE;
+
+done:
+    cpu->pc = 4000 + 4 * (int)(ins - code);
+    cpu->insn_completed = insn_completed;
+
+    if (!cpu->quiet && !cpu->sampled)
+    {
+        printf("APEX_CPU: Functional Simulation Complete, "
+               "instructions = %lld\n", cpu->insn_completed);
+    }
+}
@@ -0,0 +1,328 @@
+/*
+ * apex_image.c
+ * Contains functions to write and load pre-assembled APEX program images
+ *
+ * An image is a header followed by code memory, stored as an array of
+ * APEX_Instruction exactly as the simulator uses it, and optionally the
+ * initial contents of data memory. Loading an image maps the file and uses
+ * the instruction array in place, so there is nothing to parse. Images use
+ * the host byte order.
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+#define APEX_IMAGE_MAGIC "APXB"
+
+/* Bump whenever the layout of the header or of APEX_Instruction changes */
+#define APEX_IMAGE_VERSION 1
+
+typedef struct APEX_Image_Header
+{
+    char magic[4];             /* APEX_IMAGE_MAGIC */
+    uint32_t version;          /* APEX_IMAGE_VERSION */
+    uint32_t code_memory_size; /* Number of instructions */
+    uint32_t data_memory_size; /* Number of initial data memory words */
+    uint32_t checksum;         /* Checksum of everything after the header */
+    uint32_t reserved;
+} APEX_Image_Header;
+
+_Static_assert(sizeof(APEX_Instruction) == 8,
+               "APEX_Instruction layout is part of the image format");
+_Static_assert(sizeof(APEX_Image_Header) % sizeof(APEX_Instruction) == 0,
+               "Code memory must stay aligned after the header");
+
+/* FNV-1a over 32-bit words */
+static uint32_t
+get_image_checksum(const uint32_t *words, size_t count, uint32_t hash)
+{
+    size_t i;
+
+    for (i = 0; i < count; ++i)
+    {
+        hash ^= words[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Reads initial data memory words, whitespace separated decimal integers
+ * stored from address 0 on
+ */
+static int *
+read_data_file(const char *filename, int *size)
+{
+    FILE *fp;
+    int *data, *grown;
+    int value, capacity;
+
+    *size = 0;
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open data file %s\n", filename);
+        return NULL;
+    }
+
+    capacity = DATA_MEMORY_SIZE;
+    data = malloc(capacity * sizeof(int));
+    if (!data)
+    {
+        fclose(fp);
+        return NULL;
+    }
+
+    /* The image holds any number of words, loading checks they fit */
+    while (fscanf(fp, "%d", &value) == 1)
+    {
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            grown = realloc(data, capacity * sizeof(int));
+            if (!grown)
+            {
+                free(data);
+                fclose(fp);
+                return NULL;
+            }
+            data = grown;
+        }
+        data[(*size)++] = value;
+    }
+
+    fclose(fp);
+    return data;
+}
+
+/*
+ * Returns TRUE if the file starts with the image magic number
+ */
+int
+APEX_image_probe(const char *filename)
+{
+    char magic[4];
+    FILE *fp;
+    int found;
+
+    fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        return FALSE;
+    }
+
+    found = fread(magic, 1, sizeof(magic), fp) == sizeof(magic)
+            && memcmp(magic, APEX_IMAGE_MAGIC, sizeof(magic)) == 0;
+
+    fclose(fp);
+    return found;
+}
+
+/*
+ * Parses an assembly file, with optional initial data memory from data_file
+ * (may be NULL), and writes it out as an image. Returns 0 on success.
+ */
+int
+APEX_image_assemble(const char *filename, const char *data_file,
+                    const char *image_file)
+{
+    APEX_Image_Header header;
+    APEX_Instruction *code_memory;
+    int code_memory_size = 0;
+    int *data_memory = NULL;
+    int data_memory_size = 0;
+    FILE *fp;
+    int ret = -1;
+
+    code_memory = create_code_memory(filename, &code_memory_size);
+    if (!code_memory)
+    {
+        fprintf(stderr, "APEX_Error: Unable to assemble %s\n", filename);
+        return -1;
+    }
+
+    if (data_file)
+    {
+        data_memory = read_data_file(data_file, &data_memory_size);
+        if (!data_memory)
+        {
+            free(code_memory);
+            return -1;
+        }
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, APEX_IMAGE_MAGIC, sizeof(header.magic));
+    header.version = APEX_IMAGE_VERSION;
+    header.code_memory_size = code_memory_size;
+    header.data_memory_size = data_memory_size;
+    header.checksum = get_image_checksum(
+        (const uint32_t *)code_memory,
+        code_memory_size * sizeof(APEX_Instruction) / sizeof(uint32_t),
+        2166136261u);
+    header.checksum = get_image_checksum((const uint32_t *)data_memory,
+                                         data_memory_size, header.checksum);
+
+    fp = fopen(image_file, "wb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create %s\n", image_file);
+    }
+    else
+    {
+        if (fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(code_memory, sizeof(APEX_Instruction), code_memory_size,
+                      fp) == (size_t)code_memory_size
+            && fwrite(data_memory, sizeof(int), data_memory_size, fp)
+                   == (size_t)data_memory_size)
+        {
+            ret = 0;
+        }
+        if (fclose(fp) != 0)
+        {
+            ret = -1;
+        }
+        if (ret)
+        {
+            fprintf(stderr, "APEX_Error: Unable to write %s\n", image_file);
+        }
+    }
+
+    free(data_memory);
+    free(code_memory);
+    return ret;
+}
+
+/*
+ * Maps an image, pointing cpu->code_memory into the mapping and copying the
+ * initial data memory. Returns 0 on success.
+ */
+int
+APEX_image_load(APEX_CPU *cpu, const char *filename)
+{
+    const APEX_Image_Header *header;
+    const APEX_Instruction *code;
+    struct stat st;
+    const char *image;
+    const int *data;
+    size_t code_bytes, data_bytes;
+    uint32_t checksum, i;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(APEX_Image_Header))
+    {
+        close(fd);
+        return -1;
+    }
+
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    header = (const APEX_Image_Header *)image;
+    code_bytes = (size_t)header->code_memory_size * sizeof(APEX_Instruction);
+    data_bytes = (size_t)header->data_memory_size * sizeof(int);
+
+    if (memcmp(header->magic, APEX_IMAGE_MAGIC, sizeof(header->magic)) != 0
+        || header->version != APEX_IMAGE_VERSION)
+    {
+        fprintf(stderr, "APEX_Error: %s is not a version %d image\n",
+                filename, APEX_IMAGE_VERSION);
+        munmap((void *)image, st.st_size);
+        return -1;
+    }
+
+    if (header->code_memory_size == 0
+        || header->data_memory_size > INT32_MAX
+        || sizeof(*header) + code_bytes + data_bytes != (size_t)st.st_size)
+    {
+        fprintf(stderr, "APEX_Error: %s is truncated or corrupt\n", filename);
+        munmap((void *)image, st.st_size);
+        return -1;
+    }
+
+    checksum = get_image_checksum((const uint32_t *)(header + 1),
+                                  (code_bytes + data_bytes) / sizeof(uint32_t),
+                                  2166136261u);
+    if (checksum != header->checksum)
+    {
+        fprintf(stderr, "APEX_Error: %s fails its checksum\n", filename);
+        munmap((void *)image, st.st_size);
+        return -1;
+    }
+
+    /* The checksum only catches damage, not an image assembled wrong */
+    code = (const APEX_Instruction *)(header + 1);
+    for (i = 0; i < header->code_memory_size; ++i)
+    {
+        if (!APEX_instruction_valid(code[i].opcode, code[i].rd, code[i].rs1,
+                                    code[i].rs2))
+        {
+            fprintf(stderr, "APEX_Error: %s has an invalid instruction at "
+                            "pc(%u)\n", filename, 4000 + 4 * i);
+            munmap((void *)image, st.st_size);
+            return -1;
+        }
+    }
+
+    if (header->data_memory_size > (uint32_t)cpu->data_memory.size)
+    {
+        fprintf(stderr, "APEX_Error: %s needs %u words of data memory, %d "
+                        "configured\n", filename, header->data_memory_size,
+                cpu->data_memory.size);
+        munmap((void *)image, st.st_size);
+        return -1;
+    }
+
+    /* Zero words are left unwritten so their pages stay unallocated */
+    data = (const int *)(image + sizeof(*header) + code_bytes);
+    for (i = 0; i < header->data_memory_size; ++i)
+    {
+        if (data[i] && APEX_memory_write(&cpu->data_memory, i, data[i]))
+        {
+            munmap((void *)image, st.st_size);
+            return -1;
+        }
+    }
+
+    cpu->image = (void *)image;
+    cpu->image_size = st.st_size;
+    cpu->code_memory = (APEX_Instruction *)code;
+    cpu->code_memory_size = header->code_memory_size;
+    return 0;
+}
+
+/*
+ * Releases code memory of a CPU, unmapping it if it came from an image
+ */
+void
+APEX_image_unload(APEX_CPU *cpu)
+{
+    if (cpu->image)
+    {
+        munmap(cpu->image, cpu->image_size);
+        cpu->image = NULL;
+    }
+    else
+    {
+        free(cpu->code_memory);
+    }
+    cpu->code_memory = NULL;
+}
@@ -0,0 +1,186 @@
+/*
+ * apex_isa.h
+ * Contains the APEX instruction set, one row of APEX_ISA per opcode
+ *
+ * A row gives everything the simulator knows about an instruction: its
+ * mnemonic, its operands in assembly order, the unit executing it, the
+ * operation computing its result, how it sets the flags, when it branches
+ * and which registers and memory it reads and writes. Parsing, printing,
+ * decode hazard checks, execute, memory, writeback and the functional model
+ * are all driven by it, so adding an instruction takes an OPCODE_ number in
+ * apex_macros.h and a row here.
+ *
+ * Rows are kept sorted by mnemonic, as the parser looks mnemonics up by a
+ * binary search in row order. The rows expand to the apex_isa table. Execute
+ * dispatches on the opcode with one case per row, each inlining the stage
+ * with its row as a constant, so every case compiles down to just that
+ * instruction's work.
+ */
+#ifndef _APEX_ISA_H_
+#define _APEX_ISA_H_
+
+#include "apex_macros.h"
+
+/*
+ * Operations computing the result of an instruction from its first operand
+ * (rs1) and its second operand (rs2, or imm with APEX_OP_IMM). Loads and
+ * stores compute their address with APEX_ALU_ADD.
+ */
+#define APEX_ALU_NONE 0
+#define APEX_ALU_ADD 1
+#define APEX_ALU_SUB 2
+#define APEX_ALU_MUL 3
+#define APEX_ALU_DIV 4
+#define APEX_ALU_AND 5
+#define APEX_ALU_OR 6
+#define APEX_ALU_XOR 7
+#define APEX_ALU_MOVE 8 /* The second operand */
+
+/* Flag updates: none, from the result, or comparing the two operands */
+#define APEX_CC_NONE 0
+#define APEX_CC_RESULT 1
+#define APEX_CC_COMPARE 2
+
+/* Branch conditions. PC relative unless the instruction reads rs1 */
+#define APEX_BRANCH_NEVER 0
+#define APEX_BRANCH_ZERO 1
+#define APEX_BRANCH_NOT_ZERO 2
+#define APEX_BRANCH_POS 3
+#define APEX_BRANCH_NOT_POS 4
+#define APEX_BRANCH_ALWAYS 5
+
+/* Registers and memory an instruction reads and writes */
+#define APEX_OP_RS1 0x01   /* Reads rs1 */
+#define APEX_OP_RS2 0x02   /* Reads rs2 */
+#define APEX_OP_IMM 0x04   /* The second operand is imm, not rs2 */
+#define APEX_OP_RD 0x08    /* Writes its result to rd */
+#define APEX_OP_RS1_INC 0x10 /* Writes rs1 + 4 back to rs1 */
+#define APEX_OP_LOAD 0x20  /* Loads rd from the computed address */
+#define APEX_OP_STORE 0x40 /* Stores rs2 to the computed address */
+
+typedef struct APEX_Opcode
+{
+    const char *name;      /* Mnemonic, NULL for an undefined opcode */
+    const char *operands;  /* Assembly operands: d rd, s rs1, t rs2, i imm.
+                              A blank is printed after them as shown */
+    unsigned char unit;    /* APEX_FU_* executing it */
+    unsigned char alu;     /* APEX_ALU_* */
+    unsigned char cc;      /* APEX_CC_* */
+    unsigned char branch;  /* APEX_BRANCH_* */
+    unsigned char effects; /* APEX_OP_* bits */
+} APEX_Opcode;
+
+#define APEX_RRR (APEX_OP_RS1 | APEX_OP_RS2 | APEX_OP_RD)
+#define APEX_RRI (APEX_OP_RS1 | APEX_OP_IMM | APEX_OP_RD)
+
+/* X(opcode, mnemonic, operands, unit, alu, cc, branch, effects) */
+#define APEX_ISA(X)                                                            \
+    X(OPCODE_ADD, "ADD", "dst ", APEX_FU_ALU, APEX_ALU_ADD, APEX_CC_RESULT,    \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_ADDL, "ADDL", "dsi ", APEX_FU_ALU, APEX_ALU_ADD, APEX_CC_RESULT,  \
+      APEX_BRANCH_NEVER, APEX_RRI)                                             \
+    X(OPCODE_AND, "AND", "dst ", APEX_FU_ALU, APEX_ALU_AND, APEX_CC_NONE,      \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_BNP, "BNP", "i ", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,       \
+      APEX_BRANCH_NOT_POS, 0)                                                  \
+    X(OPCODE_BNZ, "BNZ", "i ", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,       \
+      APEX_BRANCH_NOT_ZERO, 0)                                                 \
+    X(OPCODE_BP, "BP", "i ", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,         \
+      APEX_BRANCH_POS, 0)                                                      \
+    X(OPCODE_BZ, "BZ", "i ", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,         \
+      APEX_BRANCH_ZERO, 0)                                                     \
+    X(OPCODE_CMP, "CMP", "st", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_COMPARE,    \
+      APEX_BRANCH_NEVER, APEX_OP_RS1 | APEX_OP_RS2)                            \
+    X(OPCODE_DIV, "DIV", "dst ", APEX_FU_DIV, APEX_ALU_DIV, APEX_CC_RESULT,    \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_XOR, "EXOR", "dst ", APEX_FU_ALU, APEX_ALU_XOR, APEX_CC_NONE,     \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_HALT, "HALT", "", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,       \
+      APEX_BRANCH_NEVER, 0)                                                    \
+    X(OPCODE_JUMP, "JUMP", "si ", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,    \
+      APEX_BRANCH_ALWAYS, APEX_OP_RS1)                                         \
+    X(OPCODE_LDI, "LDI", "dsi ", APEX_FU_AGU, APEX_ALU_ADD, APEX_CC_NONE,      \
+      APEX_BRANCH_NEVER, APEX_RRI | APEX_OP_LOAD | APEX_OP_RS1_INC)            \
+    X(OPCODE_LOAD, "LOAD", "dsi ", APEX_FU_AGU, APEX_ALU_ADD, APEX_CC_NONE,    \
+      APEX_BRANCH_NEVER, APEX_RRI | APEX_OP_LOAD)                              \
+    X(OPCODE_MOVC, "MOVC", "di ", APEX_FU_ALU, APEX_ALU_MOVE, APEX_CC_NONE,    \
+      APEX_BRANCH_NEVER, APEX_OP_IMM | APEX_OP_RD)                             \
+    X(OPCODE_MUL, "MUL", "dst ", APEX_FU_MUL, APEX_ALU_MUL, APEX_CC_RESULT,    \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_NOP, "NOP", "", APEX_FU_ALU, APEX_ALU_NONE, APEX_CC_NONE,         \
+      APEX_BRANCH_NEVER, 0)                                                    \
+    X(OPCODE_OR, "OR", "dst ", APEX_FU_ALU, APEX_ALU_OR, APEX_CC_NONE,         \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_STI, "STI", "tsi ", APEX_FU_AGU, APEX_ALU_ADD, APEX_CC_NONE,      \
+      APEX_BRANCH_NEVER,                                                       \
+      APEX_OP_RS1 | APEX_OP_RS2 | APEX_OP_IMM | APEX_OP_STORE                  \
+          | APEX_OP_RS1_INC)                                                   \
+    X(OPCODE_STORE, "STORE", "tsi ", APEX_FU_AGU, APEX_ALU_ADD, APEX_CC_NONE,  \
+      APEX_BRANCH_NEVER,                                                       \
+      APEX_OP_RS1 | APEX_OP_RS2 | APEX_OP_IMM | APEX_OP_STORE)                 \
+    X(OPCODE_SUB, "SUB", "dst ", APEX_FU_ALU, APEX_ALU_SUB, APEX_CC_RESULT,    \
+      APEX_BRANCH_NEVER, APEX_RRR)                                             \
+    X(OPCODE_SUBL, "SUBL", "dsi ", APEX_FU_ALU, APEX_ALU_SUB, APEX_CC_RESULT,  \
+      APEX_BRANCH_NEVER, APEX_RRI)
+
+#define APEX_ISA_ROW(opcode, name, operands, unit, alu, cc, branch, effects)   \
+    [opcode] = { name, operands, unit, alu, cc, branch, effects },
+
+/* Indexed by any opcode byte, undefined ones execute like NOP */
+static const APEX_Opcode apex_isa[256] = { APEX_ISA(APEX_ISA_ROW) };
+
+/*
+ * Computes an operation of the ALU. Arithmetic wraps around in two's
+ * complement. Division truncates toward zero, a division by zero gives -1
+ * and INT_MIN / -1 gives INT_MIN, so no operand traps.
+ */
+static inline int
+apex_alu(const int alu, const int a, const int b)
+{
+    switch (alu)
+    {
+        case APEX_ALU_ADD:
+            return (int)((unsigned int)a + (unsigned int)b);
+        case APEX_ALU_SUB:
+            return (int)((unsigned int)a - (unsigned int)b);
+        case APEX_ALU_MUL:
+            return (int)((unsigned int)a * (unsigned int)b);
+        case APEX_ALU_DIV:
+            if (b == 0)
+            {
+                return -1;
+            }
+            return b == -1 ? (int)(0u - (unsigned int)a) : a / b;
+        case APEX_ALU_AND:
+            return a & b;
+        case APEX_ALU_OR:
+            return a | b;
+        case APEX_ALU_XOR:
+            return a ^ b;
+        case APEX_ALU_MOVE:
+            return b;
+    }
+    return 0;
+}
+
+/* Returns TRUE if a branch condition holds for the given flags */
+static inline int
+apex_branch_taken(const int branch, const int zero_flag, const int pos_flag)
+{
+    switch (branch)
+    {
+        case APEX_BRANCH_ZERO:
+            return zero_flag == TRUE;
+        case APEX_BRANCH_NOT_ZERO:
+            return zero_flag == FALSE;
+        case APEX_BRANCH_POS:
+            return pos_flag == TRUE;
+        case APEX_BRANCH_NOT_POS:
+            return pos_flag == FALSE;
+        case APEX_BRANCH_ALWAYS:
+            return TRUE;
+    }
+    return FALSE;
+}
+
+#endif
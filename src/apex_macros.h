@@ -0,0 +1,100 @@
+/*
+ * apex_macros.h
+ * Contains APEX cpu pipeline macros
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#ifndef _MACROS_H_
+#define _MACROS_H_
+
+#define FALSE 0x0
+#define TRUE 0x1
+
+/* Integers */
+#define DATA_MEMORY_SIZE 4096
+
+/* Size of integer register file */
+#define REG_FILE_SIZE 16
+
+/* Numeric OPCODE identifiers for instructions */
+#define OPCODE_ADD 0x0
+#define OPCODE_SUB 0x1
+#define OPCODE_MUL 0x2
+#define OPCODE_DIV 0x3
+#define OPCODE_AND 0x4
+#define OPCODE_OR 0x5
+#define OPCODE_XOR 0x6
+#define OPCODE_MOVC 0x7
+#define OPCODE_LOAD 0x8
+#define OPCODE_STORE 0x9
+#define OPCODE_BZ 0xa
+#define OPCODE_BNZ 0xb
+#define OPCODE_HALT 0xc
+#define OPCODE_ADDL 0xd
+#define OPCODE_SUBL 0xe
+#define OPCODE_BP 0xf
+#define OPCODE_BNP 0x10
+#define OPCODE_CMP 0x11
+#define OPCODE_NOP 0x12
+#define OPCODE_JUMP 0x13
+#define OPCODE_LDI 0x14
+#define OPCODE_STI 0x15
+
+/* Scoreboard state of a register in regsStatus */
+#define REG_VALID 0
+#define REG_BUSY 1
+#define REG_FORWARDED 2
+
+/* Forwarding policies: none, EX output only, or EX and MEM outputs */
+#define APEX_FORWARD_NONE 0
+#define APEX_FORWARD_EX 1
+#define APEX_FORWARD_FULL 2
+
+/* Policy used when a run does not choose one, set per part by the Makefile */
+#ifndef APEX_DEFAULT_FORWARDING
+#define APEX_DEFAULT_FORWARDING APEX_FORWARD_NONE
+#endif
+
+/* Coherence protocols of the data caches of a system, see apex_system.c */
+#define APEX_COHERENCE_MSI 0
+#define APEX_COHERENCE_MESI 1
+
+/* Back ends: in-order issue, or out-of-order, see apex_ooo.h */
+#define APEX_CORE_INORDER 0
+#define APEX_CORE_OOO 1
+
+/* Functional units of execute */
+#define APEX_FU_ALU 0 /* Arithmetic, logic, moves, compares and branches */
+#define APEX_FU_MUL 1
+#define APEX_FU_DIV 2
+#define APEX_FU_AGU 3 /* Address generation of loads and stores */
+#define APEX_FU_COUNT 4
+
+/* Longest unit latency, execute holds the group completing in each cycle */
+#define APEX_FU_MAX_LATENCY 16
+#define APEX_FU_MASK (APEX_FU_MAX_LATENCY - 1)
+
+/* Most instructions fetched, decoded and issued per cycle */
+#define APEX_MAX_WIDTH 4
+
+/* Pipeline stages in a trace record, in the order they are printed */
+#define APEX_TRACE_WRITEBACK 0
+#define APEX_TRACE_MEMORY 1
+#define APEX_TRACE_EXECUTE 2
+#define APEX_TRACE_DECODE 3
+#define APEX_TRACE_FETCH 4
+#define APEX_TRACE_STAGES 5
+
+/* Trace formats: display output, or records rendered later */
+#define APEX_TRACE_TEXT 0
+#define APEX_TRACE_BINARY 1
+
+/* Set this flag to 1 to enable debug messages */
+#define ENABLE_DEBUG_MESSAGES 1
+
+/* Set this flag to 1 to enable cycle single-step mode */
+#define ENABLE_SINGLE_STEP 1
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * apex_memory.c
+ * Contains the allocation of the paged data memory, see apex_memory.h
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_memory.h"
+
+/*
+ * Creates an empty memory of size words. Only the page table is allocated.
+ * Returns 0 on success.
+ */
+int
+APEX_memory_init(APEX_Memory *mem, int size)
+{
+    mem->size = 0;
+    mem->num_pages = 0;
+    mem->pages = NULL;
+    if (size <= 0)
+    {
+        fprintf(stderr, "APEX_Error: Invalid data memory size %d\n", size);
+        return -1;
+    }
+
+    mem->num_pages = (int)(((long long)size + APEX_PAGE_WORDS - 1)
+                           >> APEX_PAGE_SHIFT);
+    mem->pages = calloc(mem->num_pages, sizeof(APEX_Page *));
+    if (!mem->pages)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate %d words of data "
+                        "memory\n", size);
+        mem->num_pages = 0;
+        return -1;
+    }
+    mem->size = size;
+    return 0;
+}
+
+/* Drops a reference to a page, freeing it with the last one */
+static void
+release_page(APEX_Page *page)
+{
+    if (page && __atomic_sub_fetch(&page->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    {
+        free(page);
+    }
+}
+
+/*
+ * Releases every page and the page table
+ */
+void
+APEX_memory_free(APEX_Memory *mem)
+{
+    int i;
+
+    for (i = 0; i < mem->num_pages; ++i)
+    {
+        release_page(mem->pages[i]);
+    }
+    free(mem->pages);
+    mem->pages = NULL;
+    mem->num_pages = 0;
+    mem->size = 0;
+}
+
+/*
+ * Makes dst a copy of src sharing all of its pages, which both copy on their
+ * next store. Costs the page table, no data is copied. Returns 0 on success.
+ */
+int
+APEX_memory_share(APEX_Memory *dst, const APEX_Memory *src)
+{
+    int i;
+
+    if (APEX_memory_init(dst, src->size))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < src->num_pages; ++i)
+    {
+        if (src->pages[i])
+        {
+            __atomic_add_fetch(&src->pages[i]->refs, 1, __ATOMIC_RELAXED);
+            dst->pages[i] = src->pages[i];
+        }
+    }
+    return 0;
+}
+
+/*
+ * Makes the page holding an in-bounds address writable before a store:
+ * allocates it zeroed on its first store, or copies it if it is shared.
+ * Returns the page, or NULL if it cannot be allocated.
+ */
+APEX_Page *
+APEX_memory_touch(APEX_Memory *mem, int address)
+{
+    APEX_Page **entry = &mem->pages[address >> APEX_PAGE_SHIFT];
+    APEX_Page *page;
+
+    if (*entry && __atomic_load_n(&(*entry)->refs, __ATOMIC_ACQUIRE) == 1)
+    {
+        return *entry;
+    }
+
+    page = *entry ? malloc(sizeof(APEX_Page)) : calloc(1, sizeof(APEX_Page));
+    if (!page)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate data memory page "
+                        "at address %d\n", address);
+        return NULL;
+    }
+
+    if (*entry)
+    {
+        memcpy(page->words, (*entry)->words, sizeof(page->words));
+        release_page(*entry);
+    }
+    page->refs = 1;
+    *entry = page;
+    return page;
+}
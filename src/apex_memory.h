@@ -0,0 +1,90 @@
+/*
+ * apex_memory.h
+ * Contains the paged data memory of the APEX cpu
+ *
+ * Data memory is a page table of 4 KB pages, allocated on the first store to
+ * them, so a large address space costs only the pages a program writes. Loads
+ * from a page never written read 0 without allocating it. Accesses inline to
+ * a bounds check and a page table lookup, only the first store to a page
+ * calls out of line.
+ *
+ * Pages are reference counted so checkpoints can share them with a running
+ * CPU. The first store to a shared page copies it, so taking a checkpoint
+ * copies no data and later costs one copy per page written since.
+ */
+#ifndef _APEX_MEMORY_H_
+#define _APEX_MEMORY_H_
+
+/* Words per page, 4 KB */
+#define APEX_PAGE_SHIFT 10
+#define APEX_PAGE_WORDS (1 << APEX_PAGE_SHIFT)
+#define APEX_PAGE_MASK (APEX_PAGE_WORDS - 1)
+
+typedef struct APEX_Page
+{
+    int words[APEX_PAGE_WORDS];
+    int refs;          /* Memories sharing this page */
+} APEX_Page;
+
+typedef struct APEX_Memory
+{
+    APEX_Page **pages; /* Page table, NULL until a page is first written */
+    int num_pages;
+    int size;          /* Addressable words */
+} APEX_Memory;
+
+int APEX_memory_init(APEX_Memory *mem, int size);
+void APEX_memory_free(APEX_Memory *mem);
+int APEX_memory_share(APEX_Memory *dst, const APEX_Memory *src);
+APEX_Page *APEX_memory_touch(APEX_Memory *mem, int address);
+
+/*
+ * Reads the word at address into value. Returns -1 if address is out of
+ * bounds.
+ */
+static inline int
+APEX_memory_read(const APEX_Memory *mem, int address, int *value)
+{
+    const APEX_Page *page;
+
+    if ((unsigned int)address >= (unsigned int)mem->size)
+    {
+        return -1;
+    }
+
+    page = mem->pages[address >> APEX_PAGE_SHIFT];
+    *value = page ? page->words[address & APEX_PAGE_MASK] : 0;
+    return 0;
+}
+
+/*
+ * Writes value to the word at address. Returns -1 if address is out of bounds
+ * or its page cannot be allocated.
+ *
+ * Note: Memories sharing pages may be used from different threads, their
+ * reference counts are atomic.
+ */
+static inline int
+APEX_memory_write(APEX_Memory *mem, int address, int value)
+{
+    APEX_Page *page;
+
+    if ((unsigned int)address >= (unsigned int)mem->size)
+    {
+        return -1;
+    }
+
+    page = mem->pages[address >> APEX_PAGE_SHIFT];
+    if (!page || __atomic_load_n(&page->refs, __ATOMIC_ACQUIRE) != 1)
+    {
+        page = APEX_memory_touch(mem, address);
+        if (!page)
+        {
+            return -1;
+        }
+    }
+    page->words[address & APEX_PAGE_MASK] = value;
+    return 0;
+}
+
+#endif
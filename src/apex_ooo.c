@@ -0,0 +1,775 @@
+/*
+ * apex_ooo.c
+ * Contains the out-of-order back end of the APEX cpu, see apex_ooo.h
+ *
+ * The run loop of apex_cpu.c calls these stages in place of writeback,
+ * memory, execute and decode when the CPU runs with core=ooo, fetch is
+ * shared.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_isa.h"
+#include "apex_macros.h"
+
+/* Returns TRUE if size lies in min to max */
+static int
+valid_size(int size, int min, int max)
+{
+    return size >= min && size <= max;
+}
+
+/*
+ * Sets up empty structures of the given sizes. The registers are mapped by
+ * APEX_ooo_reset before a run. Returns 0 on success.
+ */
+int
+APEX_ooo_init(APEX_Ooo *ooo, int rob_size, int iq_size, int lsq_size,
+              int prf_size)
+{
+    if (!valid_size(rob_size, 1, APEX_OOO_MAX_ROB)
+        || !valid_size(iq_size, 1, APEX_OOO_MAX_IQ)
+        || !valid_size(lsq_size, 1, APEX_OOO_MAX_LSQ)
+        || !valid_size(prf_size, APEX_OOO_MIN_PRF, APEX_OOO_MAX_PRF))
+    {
+        fprintf(stderr, "APEX_Error: Out-of-order core takes at most %d ROB, "
+                        "%d IQ and %d LSQ entries and %d to %d physical "
+                        "registers\n",
+                APEX_OOO_MAX_ROB, APEX_OOO_MAX_IQ, APEX_OOO_MAX_LSQ,
+                APEX_OOO_MIN_PRF, APEX_OOO_MAX_PRF);
+        return -1;
+    }
+
+    memset(ooo, 0, sizeof(APEX_Ooo));
+    ooo->rob_size = rob_size;
+    ooo->iq_size = iq_size;
+    ooo->lsq_size = lsq_size;
+    ooo->prf_size = prf_size;
+    ooo->commit_clock = -1;
+    return 0;
+}
+
+/* Returns TRUE if reg is -1 or a physical register */
+static int
+valid_reg(const APEX_Ooo *ooo, int reg)
+{
+    return reg >= -1 && reg < ooo->prf_size;
+}
+
+/*
+ * Returns TRUE if loaded structures have valid sizes, every index in them
+ * lies within those sizes and every ROB entry holds a valid instruction
+ */
+int
+APEX_ooo_valid(const APEX_Ooo *ooo)
+{
+    const APEX_ROB_Entry *entry;
+    int i, j;
+
+    if (!valid_size(ooo->rob_size, 1, APEX_OOO_MAX_ROB)
+        || !valid_size(ooo->iq_size, 1, APEX_OOO_MAX_IQ)
+        || !valid_size(ooo->lsq_size, 1, APEX_OOO_MAX_LSQ)
+        || !valid_size(ooo->prf_size, APEX_OOO_MIN_PRF, APEX_OOO_MAX_PRF)
+        || (unsigned int)ooo->rob_head >= (unsigned int)ooo->rob_size
+        || (unsigned int)ooo->rob_count > (unsigned int)ooo->rob_size
+        || (unsigned int)ooo->lsq_head >= (unsigned int)ooo->lsq_size
+        || (unsigned int)ooo->lsq_count > (unsigned int)ooo->lsq_size
+        || (unsigned int)ooo->iq_count > (unsigned int)ooo->iq_size
+        || (unsigned int)ooo->free_head >= (unsigned int)ooo->prf_size
+        || (unsigned int)ooo->free_count > (unsigned int)ooo->prf_size)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < APEX_OOO_ARCH_REGS; ++i)
+    {
+        if (ooo->rename[i] < 0 || !valid_reg(ooo, ooo->rename[i]))
+        {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < ooo->prf_size; ++i)
+    {
+        if (ooo->free_list[i] < 0 || !valid_reg(ooo, ooo->free_list[i]))
+        {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < ooo->iq_count; ++i)
+    {
+        if ((unsigned int)ooo->iq[i] >= (unsigned int)ooo->rob_size)
+        {
+            return FALSE;
+        }
+    }
+    for (i = 0; i < ooo->rob_size; ++i)
+    {
+        entry = &ooo->rob[i];
+        if (entry->lsq < -1 || entry->lsq >= ooo->lsq_size
+            || !APEX_instruction_valid(entry->opcode, entry->rd, entry->rs1,
+                                       entry->rs2))
+        {
+            return FALSE;
+        }
+        for (j = 0; j < APEX_OOO_DESTS; ++j)
+        {
+            if (!valid_reg(ooo, entry->src[j])
+                || !valid_reg(ooo, entry->dest[j])
+                || !valid_reg(ooo, entry->old[j]))
+            {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * Empties the structures and maps every architectural register and the flags
+ * to a physical register holding its value, the rest free. Runs resume from
+ * the architectural state this way whenever nothing is in flight, which is
+ * also where functional mode leaves a sampled run.
+ */
+void
+APEX_ooo_reset(APEX_CPU *cpu)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    int i;
+
+    ooo->rob_head = 0;
+    ooo->rob_count = 0;
+    ooo->lsq_head = 0;
+    ooo->lsq_count = 0;
+    ooo->iq_count = 0;
+    for (i = 0; i < REG_FILE_SIZE; ++i)
+    {
+        ooo->prf[i] = cpu->regs[i];
+    }
+    ooo->prf[APEX_OOO_FLAGS] = (cpu->zero_flag ? APEX_OOO_ZERO : 0)
+                               | (cpu->pos_flag ? APEX_OOO_POS : 0);
+    for (i = 0; i < APEX_OOO_ARCH_REGS; ++i)
+    {
+        ooo->rename[i] = i;
+        ooo->prf_ready[i] = TRUE;
+    }
+
+    ooo->free_head = 0;
+    ooo->free_count = ooo->prf_size - APEX_OOO_ARCH_REGS;
+    for (i = 0; i < ooo->free_count; ++i)
+    {
+        ooo->free_list[i] = APEX_OOO_ARCH_REGS + i;
+    }
+    memset(ooo->unit_ready, 0, sizeof(ooo->unit_ready));
+    ooo->commit_clock = -1;
+}
+
+/* Returns the ROB index of the entry age entries after the head */
+static int
+rob_index(const APEX_Ooo *ooo, int age)
+{
+    return (ooo->rob_head + age) % ooo->rob_size;
+}
+
+/* Returns how many entries an entry of the ROB is after its head */
+static int
+rob_age(const APEX_Ooo *ooo, int index)
+{
+    return (index - ooo->rob_head + ooo->rob_size) % ooo->rob_size;
+}
+
+static int
+alloc_reg(APEX_Ooo *ooo)
+{
+    const int reg = ooo->free_list[ooo->free_head];
+
+    ooo->free_head = (ooo->free_head + 1) % ooo->prf_size;
+    ooo->free_count--;
+    return reg;
+}
+
+static void
+free_reg(APEX_Ooo *ooo, int reg)
+{
+    ooo->free_list[(ooo->free_head + ooo->free_count) % ooo->prf_size] = reg;
+    ooo->free_count++;
+}
+
+/* Returns the architectural register written through destination d */
+static int
+dest_arch_reg(const APEX_ROB_Entry *entry, int d)
+{
+    if (d == APEX_OOO_DEST_RS1)
+    {
+        return entry->rs1;
+    }
+    return d == APEX_OOO_DEST_RD ? entry->rd : APEX_OOO_FLAGS;
+}
+
+/*
+ * Returns the cycles a load or store misses the data cache by, looking it up
+ * once. Accesses out of bounds, which fault, are not looked up.
+ */
+static int
+cache_cycles(APEX_CPU *cpu, APEX_ROB_Entry *entry, int write)
+{
+    if (!cpu->l1d.config.size || entry->looked_up
+        || (unsigned int)entry->address >= (unsigned int)cpu->data_memory.size)
+    {
+        return 0;
+    }
+    entry->looked_up = TRUE;
+    return APEX_cpu_cache_access(cpu, entry->pc, entry->address, write);
+}
+
+/*
+ * Writeback Stage of the out-of-order core
+ *
+ * Commits up to width completed instructions from the head of the ROB, in
+ * order. Stores write data memory here, after a data cache miss, or enter the
+ * store buffer once it has space. Returns TRUE to end the run, on HALT or at
+ * the end of a sampled window, like APEX_writeback.
+ *
+ * Note: A run stops after writeback and the next one resumes at the same
+ * clock, with writeback. That cycle has committed and been counted already.
+ */
+int
+APEX_ooo_writeback(APEX_CPU *cpu, int display, int width)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    APEX_ROB_Entry *entry;
+    const APEX_Opcode *op;
+    int i, d, reg, value, cycles, stop = FALSE;
+
+    if (ooo->commit_clock == cpu->clock)
+    {
+        return FALSE;
+    }
+    ooo->commit_clock = cpu->clock;
+
+    cpu->stats.rob_occupancy += ooo->rob_count;
+    cpu->stats.iq_occupancy += ooo->iq_count;
+
+    for (i = 0; i < width && ooo->rob_count; ++i)
+    {
+        entry = &ooo->rob[ooo->rob_head];
+        op = &apex_isa[entry->opcode];
+        if (entry->state != APEX_ROB_DONE)
+        {
+            break;
+        }
+
+        /* A store missing in the data cache commits once its line arrives,
+         * with a store buffer once that has space */
+        if ((op->effects & APEX_OP_STORE) && cpu->store_buffer.entries)
+        {
+            if (APEX_store_buffer_full(&cpu->store_buffer, cpu->clock))
+            {
+                cpu->stats.sb_stall_cycles++;
+                break;
+            }
+        }
+        else if ((op->effects & APEX_OP_STORE)
+                 && (cycles = cache_cycles(cpu, entry, TRUE)))
+        {
+            entry->done = cpu->clock + cycles;
+        }
+        if (entry->done > cpu->clock)
+        {
+            cpu->stats.cache_stall_cycles++;
+            break;
+        }
+
+        /* A faulting access stops the run, it does not commit */
+        if (entry->fault
+            || ((op->effects & APEX_OP_STORE)
+                && APEX_cpu_write(cpu, entry->address, entry->rs2_value)))
+        {
+            APEX_memory_fault(cpu, entry->pc, entry->address);
+            break;
+        }
+        if ((op->effects & APEX_OP_STORE) && cpu->store_buffer.entries)
+        {
+            APEX_cpu_buffer_store(cpu, entry->pc, entry->address);
+        }
+
+        if (entry->lsq >= 0)
+        {
+            ooo->lsq_head = (ooo->lsq_head + 1) % ooo->lsq_size;
+            ooo->lsq_count--;
+        }
+
+        for (d = 0; d < APEX_OOO_DESTS; ++d)
+        {
+            if (entry->dest[d] < 0)
+            {
+                continue;
+            }
+            reg = dest_arch_reg(entry, d);
+            value = ooo->prf[entry->dest[d]];
+            if (reg == APEX_OOO_FLAGS)
+            {
+                cpu->zero_flag = (value & APEX_OOO_ZERO) != 0;
+                cpu->pos_flag = (value & APEX_OOO_POS) != 0;
+            }
+            else
+            {
+                cpu->regs[reg] = value;
+            }
+            free_reg(ooo, entry->old[d]);
+        }
+
+        ooo->rob_head = (ooo->rob_head + 1) % ooo->rob_size;
+        ooo->rob_count--;
+        cpu->insn_completed++;
+        cpu->stats.retired[entry->opcode]++;
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_WRITEBACK, i, entry->pc,
+                             FALSE);
+        }
+
+        if (entry->opcode == OPCODE_HALT)
+        {
+            cpu->halted = TRUE;
+            return TRUE;
+        }
+
+        if (cpu->insn_completed == cpu->insn_limit)
+        {
+            stop = TRUE;
+        }
+    }
+    return stop;
+}
+
+/*
+ * Squashes every ROB entry younger than the one at index, newest first,
+ * restoring the mappings each replaced and freeing its registers, and drops
+ * them from the IQ and LSQ
+ */
+static void
+squash_after(APEX_CPU *cpu, int index)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    const int keep = rob_age(ooo, index) + 1;
+    APEX_ROB_Entry *entry;
+    int i, j, d;
+
+    while (ooo->rob_count > keep)
+    {
+        entry = &ooo->rob[rob_index(ooo, ooo->rob_count - 1)];
+        for (d = APEX_OOO_DESTS - 1; d >= 0; --d)
+        {
+            if (entry->dest[d] >= 0)
+            {
+                ooo->rename[dest_arch_reg(entry, d)] = entry->old[d];
+                free_reg(ooo, entry->dest[d]);
+            }
+        }
+        if (entry->lsq >= 0)
+        {
+            ooo->lsq_count--;
+        }
+        ooo->rob_count--;
+        cpu->stats.flushed_insns++;
+    }
+
+    for (i = 0, j = 0; i < ooo->iq_count; ++i)
+    {
+        if (rob_age(ooo, ooo->iq[i]) < keep)
+        {
+            ooo->iq[j++] = ooo->iq[i];
+        }
+    }
+    ooo->iq_count = j;
+}
+
+/*
+ * Resolves a completed branch or jump, trains the predictor with it and, if
+ * fetch went the wrong way past it, squashes everything after it and
+ * redirects fetch. Returns TRUE on a redirect.
+ */
+static int
+resolve_branch(APEX_CPU *cpu, int index, const APEX_Opcode *op)
+{
+    const APEX_ROB_Entry *entry = &cpu->ooo.rob[index];
+    const int taken = apex_branch_taken(op->branch,
+                                        (entry->flags & APEX_OOO_ZERO) != 0,
+                                        (entry->flags & APEX_OOO_POS) != 0);
+    const int target = apex_alu(APEX_ALU_ADD,
+                                (op->effects & APEX_OP_RS1) ? entry->rs1_value
+                                                            : entry->pc,
+                                entry->imm);
+
+    cpu->stats.branches++;
+    cpu->stats.taken_branches += taken;
+    if (cpu->predictor.kind != APEX_BP_NONE)
+    {
+        APEX_predictor_update(&cpu->predictor, entry->pc,
+                              op->branch != APEX_BRANCH_ALWAYS, taken, target);
+    }
+
+    if (taken ? !entry->predicted_taken || entry->predicted_pc != target
+              : entry->predicted_taken)
+    {
+        cpu->stats.mispredictions++;
+        squash_after(cpu, index);
+        APEX_cpu_redirect(cpu, taken ? target : entry->pc + 4);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Gives a load at its memory access the data of the youngest older store to
+ * the same address, else of the store buffer or data memory. Returns the
+ * cycles until it can have them instead: 1 while an older store has no
+ * address yet, or those of a data cache miss.
+ */
+static int
+load_data(APEX_CPU *cpu, APEX_ROB_Entry *entry, int *value)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    const APEX_LSQ_Entry *older;
+    int i = entry->lsq, cycles;
+
+    while (i != ooo->lsq_head)
+    {
+        i = (i - 1 + ooo->lsq_size) % ooo->lsq_size;
+        older = &ooo->lsq[i];
+        if (!older->store)
+        {
+            continue;
+        }
+        if (!older->known)
+        {
+            cpu->stats.load_wait_cycles++;
+            return 1;
+        }
+        if (older->address == entry->address)
+        {
+            cpu->stats.loads_forwarded++;
+            *value = older->data;
+            return 0;
+        }
+    }
+
+    /* Committed stores have written data memory, the buffer has the data */
+    if (cpu->store_buffer.entries && !entry->looked_up
+        && APEX_store_buffer_holds(&cpu->store_buffer, entry->address,
+                                   cpu->clock))
+    {
+        cpu->stats.sb_forwarded++;
+    }
+    else if ((cycles = cache_cycles(cpu, entry, FALSE)))
+    {
+        return cycles;
+    }
+    entry->fault = APEX_cpu_read(cpu, entry->address, value) != 0;
+    return 0;
+}
+
+/* Writes a computed value to destination d of an entry, if it has one, and
+ * wakes up the instructions reading it */
+static void
+write_dest(APEX_Ooo *ooo, const APEX_ROB_Entry *entry, int d, int value)
+{
+    if (entry->dest[d] >= 0)
+    {
+        ooo->prf[entry->dest[d]] = value;
+        ooo->prf_ready[entry->dest[d]] = TRUE;
+    }
+}
+
+/*
+ * Completes an issued instruction: computes its result or address, its
+ * incremented rs1 and its flags and writes them. A load also accesses memory
+ * and completes later if an older store has no address yet or it misses in
+ * the data cache. Returns TRUE if it redirected fetch.
+ */
+static int
+complete_op(APEX_CPU *cpu, int index, int *accesses, int display, int width)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    APEX_ROB_Entry *entry = &ooo->rob[index];
+    const APEX_Opcode *op = &apex_isa[entry->opcode];
+    const int effects = op->effects;
+    const int b = (effects & APEX_OP_IMM) ? entry->imm : entry->rs2_value;
+    int result = apex_alu(op->alu, entry->rs1_value, b);
+    int flags = 0, cycles;
+
+    if (effects & (APEX_OP_LOAD | APEX_OP_STORE))
+    {
+        entry->address = result;
+        if (effects & APEX_OP_STORE)
+        {
+            ooo->lsq[entry->lsq].known = TRUE;
+            ooo->lsq[entry->lsq].address = result;
+            ooo->lsq[entry->lsq].data = entry->rs2_value;
+        }
+        else if ((cycles = load_data(cpu, entry, &result)))
+        {
+            entry->done = cpu->clock + cycles;
+            return FALSE;
+        }
+        else if (display && *accesses < width)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_MEMORY, (*accesses)++,
+                             entry->pc, FALSE);
+        }
+    }
+
+    if (effects & APEX_OP_RS1_INC)
+    {
+        write_dest(ooo, entry, APEX_OOO_DEST_RS1,
+                   apex_alu(APEX_ALU_ADD, entry->rs1_value, 4));
+    }
+    write_dest(ooo, entry, APEX_OOO_DEST_RD, result);
+
+    /* Any non-zero result sets pos_flag, negative ones included */
+    if (op->cc == APEX_CC_RESULT)
+    {
+        flags = (result == 0 ? APEX_OOO_ZERO : 0)
+                | (result != 0 ? APEX_OOO_POS : 0);
+    }
+    else if (op->cc == APEX_CC_COMPARE)
+    {
+        flags = (entry->rs1_value == entry->rs2_value ? APEX_OOO_ZERO : 0)
+                | (entry->rs1_value > entry->rs2_value ? APEX_OOO_POS : 0);
+    }
+    write_dest(ooo, entry, APEX_OOO_DEST_FLAGS, flags);
+
+    entry->state = APEX_ROB_DONE;
+    return op->branch != APEX_BRANCH_NEVER && resolve_branch(cpu, index, op);
+}
+
+/*
+ * Completes the instructions whose unit finishes them this cycle, oldest
+ * first, so a store has its address before a younger load looks for it and a
+ * mispredicted branch squashes the younger ones before they complete
+ */
+void
+APEX_ooo_complete(APEX_CPU *cpu, int display, int width)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    APEX_ROB_Entry *entry;
+    int age, index, accesses = 0;
+
+    for (age = 0; age < ooo->rob_count; ++age)
+    {
+        index = rob_index(ooo, age);
+        entry = &ooo->rob[index];
+        if (entry->state == APEX_ROB_EXECUTING && entry->done <= cpu->clock
+            && complete_op(cpu, index, &accesses, display, width))
+        {
+            break;
+        }
+    }
+}
+
+/*
+ * Issues up to width of the oldest instructions in the IQ whose sources are
+ * ready and whose unit can take them. A pipelined unit takes any of them, a
+ * non-pipelined one only one at a time.
+ */
+void
+APEX_ooo_issue(APEX_CPU *cpu, int display, int width)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    APEX_ROB_Entry *entry;
+    const APEX_Opcode *op;
+    int i, j, unit, issued = 0;
+
+    for (i = 0, j = 0; i < ooo->iq_count; ++i)
+    {
+        entry = &ooo->rob[ooo->iq[i]];
+        op = &apex_isa[entry->opcode];
+        unit = op->unit;
+        if (issued == width || ooo->unit_ready[unit] > cpu->clock
+            || (entry->src[0] >= 0 && !ooo->prf_ready[entry->src[0]])
+            || (entry->src[1] >= 0 && !ooo->prf_ready[entry->src[1]])
+            || (entry->src[2] >= 0 && !ooo->prf_ready[entry->src[2]]))
+        {
+            ooo->iq[j++] = ooo->iq[i];
+            continue;
+        }
+
+        entry->rs1_value = entry->src[0] >= 0 ? ooo->prf[entry->src[0]] : 0;
+        entry->rs2_value = entry->src[1] >= 0 ? ooo->prf[entry->src[1]] : 0;
+        entry->flags = entry->src[2] >= 0 ? ooo->prf[entry->src[2]] : 0;
+        entry->done = cpu->clock + cpu->units[unit].latency;
+        if (!cpu->units[unit].pipelined)
+        {
+            ooo->unit_ready[unit] = entry->done;
+        }
+        if (op->effects & APEX_OP_LOAD)
+        {
+            entry->done++;
+        }
+        entry->state = APEX_ROB_EXECUTING;
+        cpu->stats.unit_ops[unit]++;
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_EXECUTE, issued,
+                             entry->pc, FALSE);
+        }
+        issued++;
+    }
+    ooo->iq_count = j;
+
+    if (issued)
+    {
+        cpu->stats.issued[issued - 1]++;
+    }
+}
+
+/* Returns the physical register an architectural one is read from, or -1 if
+ * the instruction does not read it */
+static short
+rename_src(const APEX_Ooo *ooo, int read, int reg)
+{
+    return read ? ooo->rename[reg] : -1;
+}
+
+/* Maps destination d of an entry writing it to a free physical register */
+static void
+rename_dest(APEX_Ooo *ooo, APEX_ROB_Entry *entry, int d, int write)
+{
+    const int reg = dest_arch_reg(entry, d);
+
+    entry->dest[d] = -1;
+    entry->old[d] = -1;
+    if (write)
+    {
+        entry->old[d] = ooo->rename[reg];
+        entry->dest[d] = alloc_reg(ooo);
+        ooo->rename[reg] = entry->dest[d];
+        ooo->prf_ready[entry->dest[d]] = FALSE;
+    }
+}
+
+/*
+ * Renames the instruction in a decode latch into a new ROB entry, queues it
+ * to issue and gives a load or store its LSQ entry. Holds it instead, and
+ * counts the stall, if one of them or a free physical register is missing.
+ */
+static void
+rename_op(APEX_CPU *cpu, CPU_Stage *stage)
+{
+    APEX_Ooo *ooo = &cpu->ooo;
+    const APEX_Opcode *op = &apex_isa[stage->opcode];
+    const int effects = op->effects;
+    const int memory = (effects & (APEX_OP_LOAD | APEX_OP_STORE)) != 0;
+    const int dests = ((effects & APEX_OP_RS1_INC) != 0)
+                      + ((effects & APEX_OP_RD) != 0)
+                      + (op->cc != APEX_CC_NONE);
+    APEX_ROB_Entry *entry;
+    int index;
+
+    if (ooo->rob_count == ooo->rob_size)
+    {
+        cpu->stats.rob_stall_cycles++;
+    }
+    else if (ooo->iq_count == ooo->iq_size)
+    {
+        cpu->stats.iq_stall_cycles++;
+    }
+    else if (memory && ooo->lsq_count == ooo->lsq_size)
+    {
+        cpu->stats.lsq_stall_cycles++;
+    }
+    else if (ooo->free_count < dests)
+    {
+        cpu->stats.prf_stall_cycles++;
+    }
+    else
+    {
+        index = rob_index(ooo, ooo->rob_count++);
+        entry = &ooo->rob[index];
+        entry->pc = stage->pc;
+        entry->opcode = stage->opcode;
+        entry->rd = stage->rd;
+        entry->rs1 = stage->rs1;
+        entry->rs2 = stage->rs2;
+        entry->imm = stage->imm;
+        entry->state = APEX_ROB_WAITING;
+        entry->fault = FALSE;
+        entry->looked_up = FALSE;
+        entry->predicted_taken = stage->predicted_taken;
+        entry->predicted_pc = stage->predicted_pc;
+
+        /* Sources are read through the mappings before its own */
+        entry->src[0] = rename_src(ooo, effects & APEX_OP_RS1, stage->rs1);
+        entry->src[1] = rename_src(ooo, effects & APEX_OP_RS2, stage->rs2);
+        entry->src[2] = rename_src(ooo, op->branch != APEX_BRANCH_NEVER
+                                            && op->branch != APEX_BRANCH_ALWAYS,
+                                   APEX_OOO_FLAGS);
+        rename_dest(ooo, entry, APEX_OOO_DEST_RS1, effects & APEX_OP_RS1_INC);
+        rename_dest(ooo, entry, APEX_OOO_DEST_RD, effects & APEX_OP_RD);
+        rename_dest(ooo, entry, APEX_OOO_DEST_FLAGS, op->cc != APEX_CC_NONE);
+
+        entry->lsq = -1;
+        if (memory)
+        {
+            entry->lsq = (ooo->lsq_head + ooo->lsq_count++) % ooo->lsq_size;
+            ooo->lsq[entry->lsq].store = (effects & APEX_OP_STORE) != 0;
+            ooo->lsq[entry->lsq].known = FALSE;
+        }
+        ooo->iq[ooo->iq_count++] = index;
+        stage->has_insn = FALSE;
+        stage->stall = 0;
+        return;
+    }
+
+    stage->stall = 1;
+    cpu->stats.structural_stall_cycles++;
+}
+
+/*
+ * Decode Stage of the out-of-order core
+ *
+ * Renames the decode group in order, up to the first instruction held for a
+ * missing entry or register, and holds the ones after it. The held ones move
+ * up to the front of the group.
+ */
+void
+APEX_ooo_rename(APEX_CPU *cpu, int display, int width)
+{
+    CPU_Stage *const stage = cpu->decode;
+    int i, renamed = 0;
+
+    for (i = 0; i < width && stage[i].has_insn; ++i)
+    {
+        if (renamed == i)
+        {
+            rename_op(cpu, &stage[i]);
+            renamed += !stage[i].stall;
+        }
+        else
+        {
+            stage[i].stall = 1;
+        }
+
+        if (display)
+        {
+            APEX_trace_stage(cpu->trace, APEX_TRACE_DECODE, i, stage[i].pc,
+                             stage[i].stall);
+        }
+    }
+
+    /* The held instructions move up to the front of the group */
+    if (renamed && renamed < i)
+    {
+        for (i = 0; i + renamed < width; ++i)
+        {
+            stage[i] = stage[i + renamed];
+        }
+        for (; i < width; ++i)
+        {
+            stage[i].has_insn = FALSE;
+        }
+    }
+}
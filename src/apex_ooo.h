@@ -0,0 +1,141 @@
+/*
+ * apex_ooo.h
+ * Contains the out-of-order back end of the APEX cpu
+ *
+ * With core=ooo, fetch and its branch prediction stay as they are, and decode
+ * renames instead of waiting on the scoreboard. Every register an
+ * instruction reads or writes, the flags included, is mapped to a physical
+ * register. Each destination gets a free one, so only true dependencies
+ * remain. The instruction then takes a reorder buffer (ROB) entry, an issue
+ * queue (IQ) entry and, if it is a load or store, a load/store queue (LSQ)
+ * entry, and decode holds it while one of them or a free physical register
+ * is missing.
+ *
+ * Each cycle the issue queue selects the oldest instructions whose sources
+ * are ready and whose unit can take them, up to width of them. They read
+ * their operands from the physical registers and complete after the latency
+ * of their unit, loads one cycle later for their memory access. Completing
+ * instructions write their physical registers, which wakes their dependents
+ * up to issue in the same cycle. A load reads data memory once every older
+ * store in the LSQ has its address: the youngest of them with the same
+ * address forwards its data, else memory is read, through the data caches if
+ * there are any, and a miss completes the load that much later. Stores write
+ * data memory only when they commit, a store missing in the data cache holds
+ * commit until its line arrives. With a store buffer a store commits into it
+ * instead, holding commit only while it is full, and a load of an address it
+ * still holds is forwarded from it.
+ *
+ * Branches resolve when they complete. A misprediction squashes every
+ * younger instruction, restoring the mappings they replaced newest first,
+ * and redirects fetch. Writeback commits completed instructions from the
+ * head of the ROB in order, up to width a cycle. It copies their results to
+ * the architectural registers and flags and frees the physical registers
+ * they replaced. A faulting load or store stops the run when it reaches the
+ * head, so faults on a squashed path never happen.
+ */
+#ifndef _APEX_OOO_H_
+#define _APEX_OOO_H_
+
+#include "apex_macros.h"
+
+/* Largest structures */
+#define APEX_OOO_MAX_ROB 256
+#define APEX_OOO_MAX_IQ 128
+#define APEX_OOO_MAX_LSQ 128
+#define APEX_OOO_MAX_PRF 512
+
+/* Default sizes */
+#define APEX_OOO_ROB 64
+#define APEX_OOO_IQ 32
+#define APEX_OOO_LSQ 32
+#define APEX_OOO_PRF 96
+
+/* Renamed architectural registers: the register file, then the flags */
+#define APEX_OOO_FLAGS REG_FILE_SIZE
+#define APEX_OOO_ARCH_REGS (REG_FILE_SIZE + 1)
+
+/* Fewest physical registers, every architectural one mapped and a few free */
+#define APEX_OOO_MIN_PRF 32
+
+/* Flags held in a physical register */
+#define APEX_OOO_ZERO 0x1
+#define APEX_OOO_POS 0x2
+
+/* Progress of a ROB entry */
+#define APEX_ROB_WAITING 0   /* In the issue queue */
+#define APEX_ROB_EXECUTING 1 /* Issued, completes at its done clock */
+#define APEX_ROB_DONE 2      /* Completed, waiting to commit */
+
+/* Registers an instruction writes, in the order they are renamed. A loaded
+ * rd over its rs1 is renamed last and wins */
+#define APEX_OOO_DEST_RS1 0
+#define APEX_OOO_DEST_RD 1
+#define APEX_OOO_DEST_FLAGS 2
+#define APEX_OOO_DESTS 3
+
+typedef struct APEX_ROB_Entry
+{
+    int pc;
+    unsigned char opcode;
+    unsigned char rd;
+    unsigned char rs1;
+    unsigned char rs2;
+    int imm;
+    unsigned char state;           /* APEX_ROB_* */
+    unsigned char fault;           /* Load out of bounds, faults at commit */
+    unsigned char predicted_taken; /* Set if fetch followed it */
+    unsigned char looked_up;       /* In the data cache, once */
+    int predicted_pc;
+    short src[3];                  /* Physical rs1, rs2 and flags read, or -1 */
+    short dest[APEX_OOO_DESTS];    /* Physical registers written, or -1 */
+    short old[APEX_OOO_DESTS];     /* Their previous mappings */
+    int rs1_value;                 /* Operands read at issue */
+    int rs2_value;
+    int flags;
+    int address;                   /* Of a load or store */
+    long long done;                /* Clock it completes at */
+    int lsq;                       /* Its LSQ entry, or -1 */
+} APEX_ROB_Entry;
+
+typedef struct APEX_LSQ_Entry
+{
+    int store;   /* TRUE for a store, else a load */
+    int known;   /* Address computed */
+    int address;
+    int data;    /* Stored by a store */
+} APEX_LSQ_Entry;
+
+typedef struct APEX_Ooo
+{
+    int rob_size; /* Entries of each structure */
+    int iq_size;
+    int lsq_size;
+    int prf_size; /* Physical registers */
+
+    /* Circular queues in program order */
+    int rob_head;
+    int rob_count;
+    APEX_ROB_Entry rob[APEX_OOO_MAX_ROB];
+    int lsq_head;
+    int lsq_count;
+    APEX_LSQ_Entry lsq[APEX_OOO_MAX_LSQ];
+
+    int iq_count;
+    short iq[APEX_OOO_MAX_IQ];      /* ROB entries waiting, oldest first */
+
+    short rename[APEX_OOO_ARCH_REGS]; /* Physical register of each */
+    int prf[APEX_OOO_MAX_PRF];
+    unsigned char prf_ready[APEX_OOO_MAX_PRF];
+    int free_head;                  /* Circular queue of free registers */
+    int free_count;
+    short free_list[APEX_OOO_MAX_PRF];
+    long long unit_ready[APEX_FU_COUNT]; /* First clock a unit takes an
+                                            operation */
+    long long commit_clock;         /* Clock writeback last ran at, or -1 */
+} APEX_Ooo;
+
+int APEX_ooo_init(APEX_Ooo *ooo, int rob_size, int iq_size, int lsq_size,
+                  int prf_size);
+int APEX_ooo_valid(const APEX_Ooo *ooo);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * apex_predictor.c
+ * Contains the configuration of the branch predictor, see apex_predictor.h
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_predictor.h"
+
+static const char *const predictor_names[] = {
+    [APEX_BP_NONE] = "none",
+    [APEX_BP_STATIC] = "static",
+    [APEX_BP_BIMODAL] = "bimodal",
+    [APEX_BP_GSHARE] = "gshare",
+};
+
+/* Returns TRUE if size is a power of 2 no larger than max */
+static int
+valid_size(int size, int max)
+{
+    return size > 0 && size <= max && (size & (size - 1)) == 0;
+}
+
+/*
+ * Sets up an untrained predictor of the given kind with num_counters
+ * counters, weakly not taken, and an empty BTB of btb_size entries. Returns 0
+ * on success.
+ */
+int
+APEX_predictor_init(APEX_Predictor *bp, int kind, int num_counters,
+                    int btb_size)
+{
+    if (!valid_size(num_counters, APEX_BP_MAX_COUNTERS)
+        || !valid_size(btb_size, APEX_BP_MAX_BTB))
+    {
+        fprintf(stderr, "APEX_Error: Predictor tables take a power of 2 of "
+                        "at most %d counters and %d BTB entries\n",
+                APEX_BP_MAX_COUNTERS, APEX_BP_MAX_BTB);
+        return -1;
+    }
+
+    bp->kind = kind;
+    bp->num_counters = num_counters;
+    bp->btb_size = btb_size;
+    bp->history = 0;
+    memset(bp->counters, 1, sizeof(bp->counters));
+    memset(bp->btb, 0, sizeof(bp->btb));
+    return 0;
+}
+
+/* Returns TRUE if a loaded predictor has a known kind and valid sizes */
+int
+APEX_predictor_valid(const APEX_Predictor *bp)
+{
+    return bp->kind >= APEX_BP_NONE && bp->kind <= APEX_BP_GSHARE
+           && valid_size(bp->num_counters, APEX_BP_MAX_COUNTERS)
+           && valid_size(bp->btb_size, APEX_BP_MAX_BTB);
+}
+
+/*
+ * Returns the predictor named none, static, bimodal or gshare, or -1
+ */
+int
+APEX_predictor_kind(const char *name)
+{
+    int kind;
+
+    for (kind = APEX_BP_NONE; kind <= APEX_BP_GSHARE; ++kind)
+    {
+        if (strcmp(name, predictor_names[kind]) == 0)
+        {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+const char *
+APEX_predictor_name(int kind)
+{
+    return predictor_names[kind];
+}
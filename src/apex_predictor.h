@@ -0,0 +1,138 @@
+/*
+ * apex_predictor.h
+ * Contains the branch predictor of the APEX cpu fetch stage
+ *
+ * Fetch looks every branch and jump up in a direct-mapped branch target
+ * buffer (BTB) of the targets they were last taken to. On a hit a jump is
+ * predicted taken, a conditional branch as its predictor says: static
+ * predicts backward branches taken, bimodal keeps a 2-bit counter per branch
+ * and gshare one per branch and global history, the directions of the last
+ * branches XORed into the index. Fetch then follows a taken prediction to
+ * the target in the next cycle, without a bubble. Without a predictor, or on
+ * a BTB miss, fetch falls through to the next instruction.
+ *
+ * Branches are resolved in execute, which trains the predictor, and redirects
+ * fetch when the prediction was wrong. Global history is only updated there,
+ * so a branch fetched while an earlier one is unresolved does not see it.
+ */
+#ifndef _APEX_PREDICTOR_H_
+#define _APEX_PREDICTOR_H_
+
+#include "apex_macros.h"
+
+/* Predictors of conditional branch directions */
+#define APEX_BP_NONE 0    /* Never predicted, every taken branch redirects */
+#define APEX_BP_STATIC 1  /* Backward taken, forward not taken */
+#define APEX_BP_BIMODAL 2
+#define APEX_BP_GSHARE 3
+
+/* Largest tables, sizes are powers of 2 */
+#define APEX_BP_MAX_COUNTERS 4096
+#define APEX_BP_MAX_BTB 4096
+
+/* Default table sizes */
+#define APEX_BP_COUNTERS 1024
+#define APEX_BP_BTB 256
+
+/* Cycles a redirect of fetch costs over fetching the target right after the
+ * branch: the bubble after it and the refill of decode */
+#define APEX_BP_REDIRECT_CYCLES 2
+
+typedef struct APEX_BTB_Entry
+{
+    int pc;     /* Branch, 0 for an empty entry */
+    int target; /* Where it was last taken to */
+} APEX_BTB_Entry;
+
+typedef struct APEX_Predictor
+{
+    int kind;         /* APEX_BP_* */
+    int num_counters; /* Counters of bimodal and gshare */
+    int btb_size;     /* Entries of the BTB */
+    int history;      /* Last branch directions, newest in bit 0 */
+    unsigned char counters[APEX_BP_MAX_COUNTERS]; /* 0-1 not taken, 2-3 taken */
+    APEX_BTB_Entry btb[APEX_BP_MAX_BTB];
+} APEX_Predictor;
+
+int APEX_predictor_init(APEX_Predictor *bp, int kind, int num_counters,
+                        int btb_size);
+int APEX_predictor_valid(const APEX_Predictor *bp);
+int APEX_predictor_kind(const char *name);
+const char *APEX_predictor_name(int kind);
+
+/* Returns the counter predicting a conditional branch */
+static inline int
+APEX_predictor_counter(const APEX_Predictor *bp, int pc)
+{
+    int index = pc >> 2;
+
+    if (bp->kind == APEX_BP_GSHARE)
+    {
+        index ^= bp->history;
+    }
+    return index & (bp->num_counters - 1);
+}
+
+/*
+ * Predicts the branch or jump fetched at pc, a conditional one going
+ * backward if backward is set. Returns TRUE and its target if it is
+ * predicted taken. Counts the BTB lookup in *hits if it hits.
+ */
+static inline int
+APEX_predictor_predict(const APEX_Predictor *bp, int pc, int conditional,
+                       int backward, int *target, long long *hits)
+{
+    const APEX_BTB_Entry *entry = &bp->btb[(pc >> 2) & (bp->btb_size - 1)];
+
+    if (entry->pc != pc)
+    {
+        return FALSE;
+    }
+
+    (*hits)++;
+    *target = entry->target;
+    if (!conditional)
+    {
+        return TRUE;
+    }
+    if (bp->kind == APEX_BP_STATIC)
+    {
+        return backward;
+    }
+    return bp->counters[APEX_predictor_counter(bp, pc)] >= 2;
+}
+
+/*
+ * Trains the predictor with a resolved branch or jump: its counter and the
+ * global history if it is conditional, and its BTB entry if it was taken
+ */
+static inline void
+APEX_predictor_update(APEX_Predictor *bp, int pc, int conditional, int taken,
+                      int target)
+{
+    unsigned char *counter;
+    APEX_BTB_Entry *entry;
+
+    if (conditional && bp->kind >= APEX_BP_BIMODAL)
+    {
+        counter = &bp->counters[APEX_predictor_counter(bp, pc)];
+        if (taken && *counter < 3)
+        {
+            (*counter)++;
+        }
+        else if (!taken && *counter > 0)
+        {
+            (*counter)--;
+        }
+        bp->history = ((bp->history << 1) | taken) & (bp->num_counters - 1);
+    }
+
+    if (taken)
+    {
+        entry = &bp->btb[(pc >> 2) & (bp->btb_size - 1)];
+        entry->pc = pc;
+        entry->target = target;
+    }
+}
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * apex_prefetch.c
+ * Contains the configuration and training of the prefetchers, see
+ * apex_prefetch.h
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_prefetch.h"
+
+static const char *const prefetcher_names[] = {
+    [APEX_PREFETCH_NONE] = "none",
+    [APEX_PREFETCH_NEXTLINE] = "nextline",
+    [APEX_PREFETCH_STRIDE] = "stride",
+    [APEX_PREFETCH_STREAM] = "stream",
+};
+
+/* Returns TRUE if size is a power of 2 no larger than max */
+static int
+valid_size(int size, int max)
+{
+    return size > 0 && size <= max && (size & (size - 1)) == 0;
+}
+
+/*
+ * Sets up an untrained prefetcher of the given kind with a table of entries,
+ * 0 for the default of its kind, fetching degree ahead, 0 for the default.
+ * Returns 0 on success.
+ */
+int
+APEX_prefetcher_init(APEX_Prefetcher *pf, int kind, int entries, int degree)
+{
+    if (!entries)
+    {
+        entries = kind == APEX_PREFETCH_STREAM ? APEX_PREFETCH_STREAMS
+                                               : APEX_PREFETCH_STRIDE_ENTRIES;
+    }
+    if (!degree)
+    {
+        degree = APEX_PREFETCH_DEGREE;
+    }
+
+    if (!valid_size(entries, APEX_PREFETCH_MAX_ENTRIES) || degree < 1
+        || degree > APEX_PREFETCH_MAX_DEGREE)
+    {
+        fprintf(stderr, "APEX_Error: Prefetchers take a power of 2 of at most "
+                        "%d entries and a degree of 1 to %d\n",
+                APEX_PREFETCH_MAX_ENTRIES, APEX_PREFETCH_MAX_DEGREE);
+        return -1;
+    }
+
+    memset(pf, 0, sizeof(APEX_Prefetcher));
+    pf->kind = kind;
+    pf->entries = entries;
+    pf->degree = degree;
+    return 0;
+}
+
+/* Returns TRUE if a loaded prefetcher has a known kind and valid sizes */
+int
+APEX_prefetcher_valid(const APEX_Prefetcher *pf)
+{
+    return pf->kind >= APEX_PREFETCH_NONE && pf->kind <= APEX_PREFETCH_STREAM
+           && valid_size(pf->entries, APEX_PREFETCH_MAX_ENTRIES)
+           && pf->degree >= 1 && pf->degree <= APEX_PREFETCH_MAX_DEGREE;
+}
+
+/*
+ * Returns the prefetcher named none, nextline, stride or stream, or -1
+ */
+int
+APEX_prefetcher_kind(const char *name)
+{
+    int kind;
+
+    for (kind = APEX_PREFETCH_NONE; kind <= APEX_PREFETCH_STREAM; ++kind)
+    {
+        if (strcmp(name, prefetcher_names[kind]) == 0)
+        {
+            return kind;
+        }
+    }
+    return -1;
+}
+
+const char *
+APEX_prefetcher_name(int kind)
+{
+    return prefetcher_names[kind];
+}
+
+/* Prefetches line into l1 unless it lies outside memory of size words */
+static void
+prefetch_line(APEX_Cache *l1, APEX_Cache *l2, int dram_latency, int size,
+              long long line, long long clock)
+{
+    if (line >= 0 && (line << l1->line_shift) < size)
+    {
+        APEX_cache_prefetch(l1, l2, dram_latency, (int)line, clock);
+    }
+}
+
+/* Trains the stride table with a load of address at pc */
+static void
+train_stride(APEX_Prefetcher *pf, APEX_Cache *l1, APEX_Cache *l2,
+             int dram_latency, int size, int pc, int address,
+             long long clock)
+{
+    const int i = ((pc - 4000) >> 2) & (pf->entries - 1);
+    long long line, previous = address >> l1->line_shift;
+    int k, stride, repeated;
+
+    if (pf->pcs[i] != pc)
+    {
+        pf->pcs[i] = pc;
+        pf->last[i] = address;
+        pf->strides[i] = 0;
+        return;
+    }
+
+    stride = address - pf->last[i];
+    repeated = stride != 0 && stride == pf->strides[i];
+    pf->strides[i] = stride;
+    pf->last[i] = address;
+
+    for (k = 1; repeated && k <= pf->degree; ++k)
+    {
+        line = (address + (long long)k * stride) >> l1->line_shift;
+        if (line != previous)
+        {
+            prefetch_line(l1, l2, dram_latency, size, line, clock);
+            previous = line;
+        }
+    }
+}
+
+/*
+ * Trains the streams with an access to line, which missed if missed is set
+ */
+static void
+train_stream(APEX_Prefetcher *pf, APEX_Cache *l1, APEX_Cache *l2,
+             int dram_latency, int size, int line, int missed,
+             long long clock)
+{
+    int i, k, distance, victim = 0;
+
+    for (i = 0; i < pf->entries; ++i)
+    {
+        if (!pf->stamps[i])
+        {
+            continue;
+        }
+
+        distance = line - pf->last[i];
+        if (distance == 0)
+        {
+            return;
+        }
+        if (pf->strides[i] ? distance * pf->strides[i] >= 1
+                                 && distance * pf->strides[i] <= pf->degree
+                           : distance == 1 || distance == -1)
+        {
+            if (!pf->strides[i])
+            {
+                pf->strides[i] = distance;
+            }
+            pf->last[i] = line;
+            pf->stamps[i] = ++pf->tick;
+            for (k = 1; k <= pf->degree; ++k)
+            {
+                prefetch_line(l1, l2, dram_latency, size,
+                              line + (long long)k * pf->strides[i], clock);
+            }
+            return;
+        }
+    }
+
+    if (!missed)
+    {
+        return;
+    }
+
+    /* An empty stream first, else the least recently advanced one */
+    for (i = 0; i < pf->entries; ++i)
+    {
+        if (!pf->stamps[i])
+        {
+            victim = i;
+            break;
+        }
+        if (pf->tick - pf->stamps[i] > pf->tick - pf->stamps[victim])
+        {
+            victim = i;
+        }
+    }
+    pf->last[victim] = line;
+    pf->strides[victim] = 0;
+    pf->stamps[victim] = ++pf->tick;
+}
+
+/*
+ * Trains a data prefetcher with a load at pc of address in data memory of
+ * size words, which missed l1 if missed is set, and prefetches the lines it
+ * then expects into l1 at clock
+ */
+void
+APEX_prefetch_train(APEX_Prefetcher *pf, APEX_Cache *l1, APEX_Cache *l2,
+                    int dram_latency, int size, int pc, int address,
+                    int missed, long long clock)
+{
+    const int line = address >> l1->line_shift;
+    int k;
+
+    if (pf->kind == APEX_PREFETCH_NEXTLINE)
+    {
+        for (k = 1; missed && k <= pf->degree; ++k)
+        {
+            prefetch_line(l1, l2, dram_latency, size, (long long)line + k,
+                          clock);
+        }
+    }
+    else if (pf->kind == APEX_PREFETCH_STRIDE)
+    {
+        train_stride(pf, l1, l2, dram_latency, size, pc, address, clock);
+    }
+    else if (pf->kind == APEX_PREFETCH_STREAM)
+    {
+        train_stream(pf, l1, l2, dram_latency, size, line, missed, clock);
+    }
+}
@@ -0,0 +1,71 @@
+/*
+ * apex_prefetch.h
+ * Contains the hardware prefetchers of the APEX cpu caches
+ *
+ * A prefetcher watches the accesses to an L1 cache and fills lines it
+ * expects to be accessed next into it, through L2 and memory like a miss.
+ * The fill arrives as late as that miss would: a demand access hitting the
+ * line before then waits for the rest, after it takes an ordinary hit. The
+ * cache counts the prefetches, the useful ones hit by a demand access and,
+ * of those, the late ones.
+ *
+ * The instruction cache can prefetch the line after each miss (nextline).
+ * The data cache watches the loads, LOAD and LDI, with one of:
+ *
+ * nextline: each miss fetches the degree lines after it.
+ * stride: a table indexed by the PC of a load keeps the address it last
+ *         read and the stride between its last two addresses. Once a load
+ *         repeats its stride, the lines of its next degree addresses are
+ *         fetched, so an LDI walking an array stays ahead of it.
+ * stream: each of the entries follows a sequential stream of lines. A miss
+ *         next to one starts a stream going up or down, each access within
+ *         the degree lines ahead of it then advances it and fetches the
+ *         degree lines after the one accessed. A miss in no stream replaces
+ *         the least recently advanced one.
+ */
+#ifndef _APEX_PREFETCH_H_
+#define _APEX_PREFETCH_H_
+
+#include "apex_cache.h"
+
+/* Prefetchers */
+#define APEX_PREFETCH_NONE 0
+#define APEX_PREFETCH_NEXTLINE 1
+#define APEX_PREFETCH_STRIDE 2
+#define APEX_PREFETCH_STREAM 3
+
+/* Largest table and degree, table sizes are powers of 2 */
+#define APEX_PREFETCH_MAX_ENTRIES 256
+#define APEX_PREFETCH_MAX_DEGREE 16
+
+/* Defaults: stride table entries, streams and lines fetched ahead */
+#define APEX_PREFETCH_STRIDE_ENTRIES 64
+#define APEX_PREFETCH_STREAMS 8
+#define APEX_PREFETCH_DEGREE 2
+
+typedef struct APEX_Prefetcher
+{
+    int kind;             /* APEX_PREFETCH_* */
+    int entries;          /* Of the stride table, or streams */
+    int degree;           /* Addresses or lines fetched ahead */
+    unsigned int tick;    /* Orders the streams' stamps */
+    int pcs[APEX_PREFETCH_MAX_ENTRIES];     /* Load of a stride entry, 0 for
+                                               none */
+    int last[APEX_PREFETCH_MAX_ENTRIES];    /* Address it last read, or line
+                                               a stream last accessed */
+    int strides[APEX_PREFETCH_MAX_ENTRIES]; /* Words, or a stream's
+                                               direction, 0 until known */
+    unsigned int stamps[APEX_PREFETCH_MAX_ENTRIES]; /* Last stream advance, 0
+                                                       for no stream */
+} APEX_Prefetcher;
+
+int APEX_prefetcher_init(APEX_Prefetcher *pf, int kind, int entries,
+                         int degree);
+int APEX_prefetcher_valid(const APEX_Prefetcher *pf);
+int APEX_prefetcher_kind(const char *name);
+const char *APEX_prefetcher_name(int kind);
+void APEX_prefetch_train(APEX_Prefetcher *pf, APEX_Cache *l1, APEX_Cache *l2,
+                         int dram_latency, int size, int pc, int address,
+                         int missed, long long clock);
+
+#endif
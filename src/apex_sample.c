@@ -0,0 +1,138 @@
+/*
+ * apex_sample.c
+ * Contains sampled simulation, estimating the CPI of a long run
+ *
+ * Following SMARTS, the run is split into periods of a fixed number of
+ * instructions. Most of each period runs functionally, the end of it runs on
+ * the pipeline: first a warmup window, which refills the pipeline and is not
+ * measured, then a measurement window, whose cycles per instruction are one
+ * sample. The mean of the samples estimates the CPI of the whole run, with a
+ * confidence interval from their standard deviation.
+ *
+ * Detailed windows run the same specialized pipeline loops as simulate mode.
+ * Switching back to functional mode squashes the instructions in flight.
+ */
+#include <math.h>
+#include <stdio.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Normal quantile of the two-sided 95% confidence interval */
+#define APEX_SAMPLE_Z95 1.96
+
+/*
+ * Runs the pipeline until insns more instructions retire, or it halts. A
+ * wide pipeline retires the rest of the group that reaches insns too.
+ * Returns the cycles taken.
+ */
+static long long
+run_detailed(APEX_CPU *cpu, long long insns)
+{
+    long long clock = cpu->clock;
+
+    cpu->insn_limit = cpu->insn_completed + insns;
+    APEX_cpu_run(cpu);
+    return cpu->clock - clock;
+}
+
+/*
+ * Runs a program sampled, for at most cpu->cycle instructions (until HALT if
+ * it is not positive), and prints the estimated cycles with their error. Each
+ * period of instructions ends with warmup detailed instructions and then
+ * window measured ones. Returns 0 on success.
+ */
+int
+APEX_sample_run(APEX_CPU *cpu, long long period, long long warmup,
+                long long window)
+{
+    const long long limit = cpu->cycle;
+    double variance, sum = 0.0, sum_squares = 0.0;
+    double cpi = 0.0, stddev = 0.0, error = 0.0;
+    long long samples = 0, detailed = 0;
+    long long start, detailed_start, window_start, cycles;
+    double sample;
+
+    if (warmup + window > period)
+    {
+        fprintf(stderr, "APEX_Error: Sample warmup and window exceed the "
+                        "period of %lld instructions\n", period);
+        return -1;
+    }
+
+    while (!cpu->halted)
+    {
+        /* Fast-forward to the detailed end of this period */
+        start = cpu->insn_completed;
+        if (limit > 0 && limit - start < period)
+        {
+            break;
+        }
+
+        APEX_cpu_flush(cpu);
+        detailed_start = start + period - warmup - window;
+        if (detailed_start > start)
+        {
+            cpu->cycle = detailed_start;
+            APEX_functional_run(cpu);
+            if (cpu->halted)
+            {
+                break;
+            }
+        }
+
+        /* Windows end on retired instructions, never on the cycle limit */
+        cpu->cycle = -1;
+        run_detailed(cpu, warmup);
+        window_start = cpu->insn_completed;
+        cycles = run_detailed(cpu, window);
+        APEX_cpu_flush(cpu);
+        detailed += cpu->insn_completed - detailed_start;
+        if (cpu->insn_completed < start + period)
+        {
+            /* Halted within the window, which is not a full sample */
+            break;
+        }
+
+        sample = (double)cycles / (cpu->insn_completed - window_start);
+        sum += sample;
+        sum_squares += sample * sample;
+        samples++;
+    }
+
+    /* Instructions after the last full period run functionally */
+    cpu->cycle = limit;
+    if (!cpu->halted)
+    {
+        APEX_functional_run(cpu);
+    }
+
+    if (samples)
+    {
+        cpi = sum / samples;
+    }
+    if (samples > 1)
+    {
+        variance = (sum_squares - samples * cpi * cpi) / (samples - 1);
+        stddev = variance > 0.0 ? sqrt(variance) : 0.0;
+        error = APEX_SAMPLE_Z95 * stddev / sqrt(samples);
+    }
+
+    if (!cpu->quiet)
+    {
+        printf("APEX_CPU: Sampled Simulation Complete, instructions = %lld "
+               "samples = %lld estimated cycles = %.0f +- %.0f (95%%)\n",
+               cpu->insn_completed, samples, cpi * cpu->insn_completed,
+               error * cpu->insn_completed);
+        fprintf(stderr, "APEX_Sample: {\"instructions\":%lld,"
+                        "\"detailed_instructions\":%lld,\"samples\":%lld,"
+                        "\"period\":%lld,\"warmup\":%lld,\"window\":%lld,"
+                        "\"cpi\":%.4f,\"cpi_stddev\":%.4f,\"cpi_error\":%.4f,"
+                        "\"confidence\":0.95,\"cycles\":%.0f,"
+                        "\"cycles_error\":%.0f}\n",
+                cpu->insn_completed, detailed, samples, period, warmup,
+                window, cpi, stddev, error, cpi * cpu->insn_completed,
+                error * cpu->insn_completed);
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * apex_store_buffer.c
+ * Contains the configuration and draining of the store buffer, see
+ * apex_store_buffer.h
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "apex_cache.h"
+#include "apex_macros.h"
+#include "apex_store_buffer.h"
+
+/*
+ * Sets up an empty store buffer of entries, 0 for none, draining a store in
+ * drain cycles, 0 for the default. Returns 0 on success.
+ */
+int
+APEX_store_buffer_init(APEX_Store_Buffer *sb, int entries, int drain)
+{
+    if (!drain)
+    {
+        drain = APEX_SB_DRAIN;
+    }
+
+    if (entries < 0 || entries > APEX_SB_MAX_ENTRIES || drain < 1
+        || drain > APEX_CACHE_MAX_LATENCY)
+    {
+        fprintf(stderr, "APEX_Error: Store buffers take at most %d entries "
+                        "and drain in 1 to %d cycles\n",
+                APEX_SB_MAX_ENTRIES, APEX_CACHE_MAX_LATENCY);
+        return -1;
+    }
+
+    memset(sb, 0, sizeof(APEX_Store_Buffer));
+    sb->entries = entries;
+    sb->drain = drain;
+    return 0;
+}
+
+/* Returns TRUE if a loaded store buffer has a valid size and queue */
+int
+APEX_store_buffer_valid(const APEX_Store_Buffer *sb)
+{
+    return sb->entries >= 0 && sb->entries <= APEX_SB_MAX_ENTRIES
+           && sb->drain >= 1 && sb->drain <= APEX_CACHE_MAX_LATENCY
+           && sb->count >= 0 && sb->count <= sb->entries && sb->head >= 0
+           && (sb->head < sb->entries || sb->head == 0);
+}
+
+/* Drops the stores drained by clock from the head of the buffer */
+static void
+retire(APEX_Store_Buffer *sb, long long clock)
+{
+    while (sb->count && sb->drained[sb->head] <= clock)
+    {
+        sb->head = (sb->head + 1) % sb->entries;
+        sb->count--;
+    }
+}
+
+/* Returns TRUE if a store at clock finds the buffer full */
+int
+APEX_store_buffer_full(APEX_Store_Buffer *sb, long long clock)
+{
+    retire(sb, clock);
+    return sb->count == sb->entries;
+}
+
+/*
+ * Puts a store to address at clock in the buffer, to drain after the stores
+ * before it in the drain cycles and the cycles it misses the data cache by.
+ * Returns the cycles the store waits for space first, 0 if the buffer is not
+ * full. The oldest store then makes way at once, its drain is already timed.
+ */
+int
+APEX_store_buffer_push(APEX_Store_Buffer *sb, int address, int cycles,
+                       long long clock)
+{
+    long long start = clock;
+    int tail, wait = 0;
+
+    retire(sb, clock);
+    if (sb->count)
+    {
+        tail = (sb->head + sb->count - 1) % sb->entries;
+        if (sb->drained[tail] > start)
+        {
+            start = sb->drained[tail];
+        }
+    }
+    if (sb->count == sb->entries)
+    {
+        wait = (int)(sb->drained[sb->head] - clock);
+        sb->head = (sb->head + 1) % sb->entries;
+        sb->count--;
+    }
+
+    tail = (sb->head + sb->count) % sb->entries;
+    sb->addresses[tail] = address;
+    sb->drained[tail] = start + sb->drain + cycles;
+    sb->count++;
+    return wait;
+}
+
+/* Returns TRUE if a store to address has not drained by clock */
+int
+APEX_store_buffer_holds(APEX_Store_Buffer *sb, int address,
+                        long long clock)
+{
+    int i;
+
+    retire(sb, clock);
+    for (i = 0; i < sb->count; ++i)
+    {
+        if (sb->addresses[(sb->head + i) % sb->entries] == address)
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,47 @@
+/*
+ * apex_store_buffer.h
+ * Contains the store buffer of the APEX cpu
+ *
+ * With a store buffer, a store no longer waits on the data cache at its
+ * memory access, in-order, or at commit, out of order. It takes the next
+ * entry of the buffer and moves on, and the buffer drains its stores in
+ * order in the background: each takes the drain cycles after the one before
+ * it, plus the cycles it misses the data cache by. A store finding the
+ * buffer full waits until its oldest store has drained.
+ *
+ * A load of an address a store in the buffer has not drained yet is
+ * forwarded that store's data and does not look the data cache up. Like the
+ * caches, the buffer only times the stores: data memory is written as a
+ * store enters it, so every load reads the value it would be forwarded.
+ */
+#ifndef _APEX_STORE_BUFFER_H_
+#define _APEX_STORE_BUFFER_H_
+
+/* Largest buffer */
+#define APEX_SB_MAX_ENTRIES 64
+
+/* Default cycles a store takes to drain on a data cache hit */
+#define APEX_SB_DRAIN 1
+
+typedef struct APEX_Store_Buffer
+{
+    int entries; /* 0 for none */
+    int drain;   /* Cycles each store takes to drain */
+
+    /* Circular queue of the stores in program order, drained ones are
+     * dropped as it is next used */
+    int head;
+    int count;
+    int addresses[APEX_SB_MAX_ENTRIES];
+    long long drained[APEX_SB_MAX_ENTRIES]; /* Clock each has drained by */
+} APEX_Store_Buffer;
+
+int APEX_store_buffer_init(APEX_Store_Buffer *sb, int entries, int drain);
+int APEX_store_buffer_valid(const APEX_Store_Buffer *sb);
+int APEX_store_buffer_full(APEX_Store_Buffer *sb, long long clock);
+int APEX_store_buffer_push(APEX_Store_Buffer *sb, int address, int cycles,
+                           long long clock);
+int APEX_store_buffer_holds(APEX_Store_Buffer *sb, int address,
+                            long long clock);
+
+#endif
@@ -0,0 +1,1439 @@
+/*
+ * apex_system.c
+ * Contains multi-core systems, APEX CPUs sharing a data memory
+ *
+ * A system file lists one core per line: "<input_file> [<options>]", the
+ * options applying to that core after those of the command line. Blank lines
+ * and lines starting with '#' are skipped. Every core runs its own program on
+ * its own pipeline and private caches, over one data memory, which starts as
+ * that of the first core's program.
+ *
+ * A directory keeps the L1 data caches coherent under the MSI or MESI
+ * protocol. It records, for each line, the cores holding it and the one
+ * holding it Modified, if any. A miss on a line another core holds Modified
+ * has it transferred from that core in c2c cycles instead of from L2 or
+ * memory, and the owner keeps it Shared, writing it back. A store to a line
+ * held clean upgrades it, in c2c cycles, and invalidates every other copy;
+ * with MESI a line no other core holds is Exclusive and upgrades silently.
+ *
+ * The cores advance in quanta of quantum cycles, by default the c2c latency:
+ * no core can act on another in fewer cycles, so a quantum that long lets
+ * them run apart for no more than one transfer. During a quantum the data
+ * memory and the directory do not change: a core reads memory as it stood at
+ * the start of the quantum, with its own stores since, and times its accesses
+ * against the directory as it stood then. It sends its stores, and the
+ * misses and upgrades the directory has to see, as messages to the home of
+ * their line: the data memory and the directory are split by page over the
+ * cores, each the home of its share. After a barrier each home applies the
+ * messages it was sent in order of clock and then core, stores to memory and
+ * the rest to the directory, and sends the downgrades and invalidations of
+ * other cores' copies to those cores, which take them on at the start of the
+ * next quantum. Every line thus sees the accesses of all cores in one order,
+ * whichever threads run the cores and homes, and every run of a system is
+ * the same. A shorter quantum is closer to lock-step, quantum=1 steps the
+ * cores cycle by cycle; a longer one runs faster, but a core may see
+ * another's stores and coherence actions up to a quantum late.
+ *
+ * Core c and home c run on host thread c modulo threads, by default one
+ * thread per core up to the processors of the host. The threads share no
+ * locks: messages pass through single-producer single-consumer queues, one
+ * from every core to every home and back, and the threads meet only at the
+ * two barriers of each quantum, after running their cores and after
+ * applying their homes' messages.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+/* Cores of a system, one bit each in a directory entry */
+#define APEX_SYSTEM_MAX_CORES 64
+
+/* Default cycles of a cache-to-cache transfer or an upgrade */
+#define APEX_SYSTEM_C2C_LATENCY 30
+
+/* Bytes of a host cache line */
+#define APEX_SYSTEM_CACHE_LINE 64
+
+/* Polls of a barrier before a waiting thread yields its processor */
+#define APEX_SYSTEM_SPINS 1024
+
+/* Messages of a core to the home of a line */
+#define APEX_MSG_STORE 0      /* Word written to data memory */
+#define APEX_MSG_READ 1       /* Line filled for a load */
+#define APEX_MSG_WRITE 2      /* Line taken for a store, other copies lost */
+
+/* Messages of a home to a core holding a line */
+#define APEX_MSG_DOWNGRADE 3  /* Keep it Shared, writing it back */
+#define APEX_MSG_INVALIDATE 4 /* Drop it */
+#define APEX_MSG_RESTORE 5    /* Take a lost copy back, dirty if value is
+                                 set */
+
+typedef struct APEX_System_Message
+{
+    long long clock;
+    int kind;    /* APEX_MSG_* */
+    int address; /* Word stored, or line */
+    int value;   /* Stored */
+} APEX_System_Message;
+
+/*
+ * Single-producer single-consumer queue of messages, a ring of capacity
+ * slots. Neither end takes a lock: the producer publishes its tail and the
+ * consumer its head, each read by the other with acquire ordering. A full
+ * ring doubles, which the producer may do as the consumer drains it only on
+ * the other side of a barrier.
+ */
+typedef struct APEX_System_Queue
+{
+    APEX_System_Message *messages;
+    unsigned int capacity; /* A power of 2, 0 until the first message */
+    unsigned int head;     /* Messages received */
+    unsigned int tail;     /* Messages sent */
+} APEX_System_Queue;
+
+/* Way of an L1 data cache invalidated by the messages of a quantum */
+typedef struct APEX_System_Lost
+{
+    int line;
+    int way;
+} APEX_System_Lost;
+
+/* Cores holding a data line */
+typedef struct APEX_Directory_Entry
+{
+    int line;         /* APEX_CACHE_INVALID for an empty entry */
+    int owner;        /* Core holding it Modified, or -1 */
+    uint64_t sharers; /* Bit of every core holding it */
+
+    /* Copies as the home applies the messages of quantum, the cores' caches
+     * taking on its downgrades and invalidations only after */
+    long long quantum;
+    uint64_t probed;  /* Cores whose cache has been looked up */
+    uint64_t present; /* Of those, the ones holding it */
+    uint64_t lost;    /* Cores whose copy a store invalidated */
+} APEX_Directory_Entry;
+
+/* Share of the directory and data memory of a system, pages whose number
+ * modulo the cores is its index. Each takes a host cache line of its own,
+ * its pending mask being set by the other cores as they run. */
+typedef struct __attribute__((aligned(APEX_SYSTEM_CACHE_LINE)))
+APEX_System_Home
+{
+    /* Open addressing table of the lines held, or once held */
+    APEX_Directory_Entry *directory;
+    int directory_mask;        /* Entries less one */
+    int directory_count;
+    uint64_t pending;          /* Bit of every core with messages for it */
+} APEX_System_Home;
+
+struct APEX_System_Core
+{
+    struct APEX_System *system;
+    APEX_CPU *cpu;
+    char *filename;
+    int id;
+    uint64_t pending;          /* Bit of every home with messages for it */
+    APEX_System_Queue *requests; /* Its queues to every home */
+
+    /* Open addressing table of the words stored this quantum, addresses -1
+     * for none */
+    int *stored;
+    int *stored_values;
+    int stored_mask;           /* Slots less one */
+    int stored_count;
+
+    /* Lines invalidated by the messages taken on so far */
+    APEX_System_Lost *lost;
+    int lost_count;
+    int lost_capacity;
+};
+
+/* Sense reversing barrier, on a host cache line of its own as the threads
+ * poll it */
+typedef struct __attribute__((aligned(APEX_SYSTEM_CACHE_LINE)))
+APEX_System_Barrier
+{
+    int arrived;               /* Threads */
+    int sense;                 /* Of the last to arrive */
+} APEX_System_Barrier;
+
+typedef struct APEX_System
+{
+    APEX_System_Core *cores;
+    APEX_System_Home *homes;   /* One per core */
+    int num_cores;
+    APEX_Memory memory;        /* Shared data memory */
+    int protocol;              /* APEX_COHERENCE_* */
+    int c2c_latency;
+    int quantum;
+    int num_threads;
+    long long cycles;          /* Cycle limit */
+    long long clock;           /* End of the last quantum */
+    long long quanta;
+    int page_line_shift;       /* Shift of a line to its page */
+    unsigned char *page_homes; /* Home of each page, its number modulo the
+                                  cores */
+    int halted;                /* Cores halted */
+    int core_failed;           /* Set if a core cannot send or take a
+                                  message, as the cores run */
+    int home_failed;           /* Set if a home cannot apply a message */
+    int started;               /* Set once the threads have been started */
+
+    /* Queue of core c to home h at requests[c * num_cores + h], and of home
+     * h to core c at actions[h * num_cores + c] */
+    APEX_System_Queue *requests;
+    APEX_System_Queue *actions;
+
+    APEX_System_Barrier barrier;
+} APEX_System;
+
+typedef struct APEX_System_Worker
+{
+    APEX_System *system;
+    int id;
+} APEX_System_Worker;
+
+static const char *const protocol_names[] = {
+    [APEX_COHERENCE_MSI] = "msi",
+    [APEX_COHERENCE_MESI] = "mesi",
+};
+
+/*
+ * Returns the protocol named msi or mesi, or -1
+ */
+int
+APEX_coherence_protocol(const char *name)
+{
+    int protocol;
+
+    for (protocol = APEX_COHERENCE_MSI; protocol <= APEX_COHERENCE_MESI;
+         ++protocol)
+    {
+        if (strcmp(name, protocol_names[protocol]) == 0)
+        {
+            return protocol;
+        }
+    }
+    return -1;
+}
+
+const char *
+APEX_coherence_name(int protocol)
+{
+    return protocol_names[protocol];
+}
+
+/* Spreads an address or line over the slots of a table */
+static unsigned int
+hash(int key)
+{
+    const unsigned int x = (unsigned int)key * 0x9e3779b1u;
+
+    return x ^ (x >> 16);
+}
+
+/* Returns the slot of address among the words a core stored, or the empty
+ * one it would take */
+static int
+stored_slot(const APEX_System_Core *core, int address)
+{
+    int i = hash(address) & core->stored_mask;
+
+    while (core->stored[i] != -1 && core->stored[i] != address)
+    {
+        i = (i + 1) & core->stored_mask;
+    }
+    return i;
+}
+
+/* Sizes a core's table of stored words to slots, empty. Returns 0 on
+ * success. */
+static int
+alloc_stored(APEX_System_Core *core, int slots)
+{
+    int *stored = malloc(slots * sizeof(int));
+    int *values = malloc(slots * sizeof(int));
+
+    if (!stored || !values)
+    {
+        free(stored);
+        free(values);
+        return -1;
+    }
+
+    free(core->stored);
+    free(core->stored_values);
+    core->stored = stored;
+    core->stored_values = values;
+    core->stored_mask = slots - 1;
+    core->stored_count = 0;
+    memset(core->stored, -1, slots * sizeof(int));
+    return 0;
+}
+
+/* Doubles a core's table of stored words. Returns 0 on success. */
+static int
+grow_stored(APEX_System_Core *core)
+{
+    const int slots = core->stored_mask + 1, count = core->stored_count;
+    int *stored = core->stored, *values = core->stored_values;
+    int i, slot;
+
+    core->stored = NULL;
+    core->stored_values = NULL;
+    if (alloc_stored(core, 2 * slots))
+    {
+        core->stored = stored;
+        core->stored_values = values;
+        return -1;
+    }
+
+    for (i = 0; i < slots; ++i)
+    {
+        if (stored[i] != -1)
+        {
+            slot = stored_slot(core, stored[i]);
+            core->stored[slot] = stored[i];
+            core->stored_values[slot] = values[i];
+        }
+    }
+    core->stored_count = count;
+    free(stored);
+    free(values);
+    return 0;
+}
+
+/* Doubles the ring of a queue holding the messages from head to tail.
+ * Returns 0 on success. */
+static int
+grow_queue(APEX_System_Queue *queue, unsigned int head, unsigned int tail)
+{
+    const unsigned int capacity = queue->capacity ? 2 * queue->capacity : 64;
+    APEX_System_Message *messages;
+    unsigned int i;
+
+    messages = malloc(capacity * sizeof(APEX_System_Message));
+    if (!messages)
+    {
+        return -1;
+    }
+    for (i = head; i != tail; ++i)
+    {
+        messages[i & (capacity - 1)] =
+            queue->messages[i & (queue->capacity - 1)];
+    }
+    free(queue->messages);
+    queue->messages = messages;
+    queue->capacity = capacity;
+    return 0;
+}
+
+/*
+ * Sends a message on queue, setting bit in the receiver's pending mask if
+ * the queue was empty. Returns 0 on success, -1 if the queue cannot grow.
+ */
+static int
+send(APEX_System_Queue *queue, uint64_t *pending, uint64_t bit,
+     long long clock, int kind, int address, int value)
+{
+    const unsigned int head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    const unsigned int tail = queue->tail;
+    APEX_System_Message *message;
+
+    if (tail - head == queue->capacity && grow_queue(queue, head, tail))
+    {
+        return -1;
+    }
+
+    message = &queue->messages[tail & (queue->capacity - 1)];
+    message->clock = clock;
+    message->kind = kind;
+    message->address = address;
+    message->value = value;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    if (tail == head)
+    {
+        __atomic_fetch_or(pending, bit, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/* Returns the first message of queue, or NULL if it is empty */
+static const APEX_System_Message *
+peek(const APEX_System_Queue *queue)
+{
+    if (queue->head == __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+    return &queue->messages[queue->head & (queue->capacity - 1)];
+}
+
+/* Drops the first message of queue */
+static void
+pop(APEX_System_Queue *queue)
+{
+    __atomic_store_n(&queue->head, queue->head + 1, __ATOMIC_RELEASE);
+}
+
+/* Returns the home of page, which may be out of bounds */
+static int
+page_home(const APEX_System *system, unsigned int page)
+{
+    return page < (unsigned int)system->memory.num_pages
+               ? system->page_homes[page]
+               : (int)(page % (unsigned int)system->num_cores);
+}
+
+/* Returns the home of the data memory word at address */
+static int
+address_home(const APEX_System *system, int address)
+{
+    return page_home(system, (unsigned int)address >> APEX_PAGE_SHIFT);
+}
+
+/* Returns the home of line */
+static int
+line_home(const APEX_System *system, int line)
+{
+    return page_home(system, (unsigned int)line >> system->page_line_shift);
+}
+
+/*
+ * Sends an access of a core at its clock to home. Returns 0 on success,
+ * else stops the core and fails the system at the barrier.
+ */
+static int
+send_request(APEX_System_Core *core, int home, int kind, int address,
+             int value)
+{
+    APEX_System *system = core->system;
+
+    if (send(&core->requests[home],
+             &system->homes[home].pending, (uint64_t)1 << core->id,
+             core->cpu->clock, kind, address, value))
+    {
+        __atomic_store_n(&system->core_failed, TRUE, __ATOMIC_RELAXED);
+        core->cpu->halted = TRUE;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Reads the data memory word at address for a core: its own last store to
+ * it this quantum, else the word as it stood at the start of the quantum.
+ * Returns -1 if address is out of bounds.
+ */
+int
+APEX_system_read(APEX_System_Core *core, int address, int *value)
+{
+    int i;
+
+    if (core->stored_count
+        && (unsigned int)address < (unsigned int)core->system->memory.size)
+    {
+        i = stored_slot(core, address);
+        if (core->stored[i] == address)
+        {
+            *value = core->stored_values[i];
+            return 0;
+        }
+    }
+    return APEX_memory_read(&core->system->memory, address, value);
+}
+
+/*
+ * Writes value to the data memory word at address for a core, seen by the
+ * other cores from the next quantum on. Returns -1 if address is out of
+ * bounds or the store cannot be sent.
+ */
+int
+APEX_system_write(APEX_System_Core *core, int address, int value)
+{
+    int i;
+
+    if ((unsigned int)address >= (unsigned int)core->system->memory.size
+        || send_request(core, address_home(core->system, address),
+                        APEX_MSG_STORE, address, value))
+    {
+        return -1;
+    }
+
+    if (2 * (core->stored_count + 1) > core->stored_mask + 1
+        && grow_stored(core))
+    {
+        __atomic_store_n(&core->system->core_failed, TRUE, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    i = stored_slot(core, address);
+    core->stored_count += core->stored[i] != address;
+    core->stored[i] = address;
+    core->stored_values[i] = value;
+    return 0;
+}
+
+/* Returns the directory entry of line in home, or NULL if no core has held
+ * it */
+static APEX_Directory_Entry *
+find_entry(const APEX_System_Home *home, int line)
+{
+    int i = hash(line) & home->directory_mask;
+
+    while (home->directory[i].line != line)
+    {
+        if (home->directory[i].line == APEX_CACHE_INVALID)
+        {
+            return NULL;
+        }
+        i = (i + 1) & home->directory_mask;
+    }
+    return &home->directory[i];
+}
+
+/* Sizes an empty directory of home to entries. Returns 0 on success. */
+static int
+alloc_directory(APEX_System_Home *home, int entries)
+{
+    int i;
+
+    home->directory = malloc(entries * sizeof(APEX_Directory_Entry));
+    if (!home->directory)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate a directory of %d "
+                        "lines\n", entries);
+        return -1;
+    }
+
+    for (i = 0; i < entries; ++i)
+    {
+        home->directory[i].line = APEX_CACHE_INVALID;
+    }
+    home->directory_mask = entries - 1;
+    home->directory_count = 0;
+    return 0;
+}
+
+/*
+ * Returns the directory entry of line in home, adding it without holders if
+ * no core has held it, or NULL if the directory cannot grow
+ */
+static APEX_Directory_Entry *
+directory_entry(APEX_System_Home *home, int line)
+{
+    APEX_Directory_Entry *old = home->directory, *entry;
+    const int entries = home->directory_mask + 1;
+    int i;
+
+    entry = find_entry(home, line);
+    if (entry)
+    {
+        return entry;
+    }
+
+    if (2 * (home->directory_count + 1) > entries)
+    {
+        if (alloc_directory(home, 2 * entries))
+        {
+            home->directory = old;
+            return NULL;
+        }
+        for (i = 0; i < entries; ++i)
+        {
+            if (old[i].line != APEX_CACHE_INVALID)
+            {
+                *directory_entry(home, old[i].line) = old[i];
+            }
+        }
+        free(old);
+    }
+
+    i = hash(line) & home->directory_mask;
+    while (home->directory[i].line != APEX_CACHE_INVALID)
+    {
+        i = (i + 1) & home->directory_mask;
+    }
+    entry = &home->directory[i];
+    entry->line = line;
+    entry->owner = -1;
+    entry->sharers = 0;
+    entry->quantum = 0;
+    home->directory_count++;
+    return entry;
+}
+
+/* Returns TRUE if the L1 data cache of a core holds line */
+static int
+holds(const APEX_System_Core *core, int line)
+{
+    const APEX_Cache *l1d = &core->cpu->l1d;
+
+    return APEX_cache_find(l1d, (line & (l1d->sets - 1)) << l1d->way_shift,
+                           line)
+           >= 0;
+}
+
+/*
+ * Looks the address of a load or store of a core up in its caches, against
+ * the directory as it stood at the start of the quantum, see
+ * APEX_cpu_cache_access. Returns the cycles the access takes beyond an L1
+ * hit.
+ */
+int
+APEX_system_cache_access(APEX_System_Core *core, int address, int write)
+{
+    const APEX_System *system = core->system;
+    APEX_CPU *cpu = core->cpu;
+    APEX_Cache *l1d = &cpu->l1d;
+    const int line = address >> l1d->line_shift;
+    const int home = line_home(system, line);
+    const int way = APEX_cache_find(
+        l1d, (line & (l1d->sets - 1)) << l1d->way_shift, line);
+    const int clean = way >= 0 && !l1d->dirty[way];
+    const APEX_Directory_Entry *entry = find_entry(&system->homes[home], line);
+    int cycles = APEX_cache_access(l1d, &cpu->l2, cpu->dram_latency, address,
+                                   write, cpu->clock);
+
+    if (way < 0)
+    {
+        if (entry && entry->owner >= 0 && entry->owner != core->id)
+        {
+            cycles = system->c2c_latency;
+            cpu->stats.coherence_transfers++;
+        }
+        send_request(core, home, write ? APEX_MSG_WRITE : APEX_MSG_READ, line,
+                     0);
+    }
+    else if (write && clean)
+    {
+        /* Exclusive lines with MESI, held by no other core */
+        if (system->protocol == APEX_COHERENCE_MSI
+            || (entry && (entry->sharers & ~((uint64_t)1 << core->id))))
+        {
+            cycles += system->c2c_latency;
+            cpu->stats.coherence_upgrades++;
+        }
+        send_request(core, home, APEX_MSG_WRITE, line, 0);
+    }
+    return cycles;
+}
+
+/*
+ * Records that an other core's store invalidated line in way of a core.
+ * Returns 0 on success.
+ */
+static int
+lose_line(APEX_System_Core *core, int line, int way)
+{
+    APEX_System_Lost *lost = core->lost;
+
+    if (core->lost_count == core->lost_capacity)
+    {
+        lost = realloc(core->lost, 2 * core->lost_capacity
+                                       * sizeof(APEX_System_Lost));
+        if (!lost)
+        {
+            return -1;
+        }
+        core->lost = lost;
+        core->lost_capacity *= 2;
+    }
+    core->lost[core->lost_count].line = line;
+    core->lost[core->lost_count++].way = way;
+    return 0;
+}
+
+/*
+ * Gives a core back its copy of line, invalidated by a store of another core
+ * before the core's own access to it. The access came after that store,
+ * unseen during the quantum, and would have fetched the line again.
+ */
+static void
+restore_line(APEX_System_Core *core, int line, int write)
+{
+    APEX_Cache *l1d = &core->cpu->l1d;
+    int i;
+
+    for (i = core->lost_count - 1; i >= 0; --i)
+    {
+        if (core->lost[i].line == line)
+        {
+            if (l1d->tags[core->lost[i].way] == APEX_CACHE_INVALID)
+            {
+                l1d->tags[core->lost[i].way] = line;
+                l1d->dirty[core->lost[i].way] = write;
+            }
+            return;
+        }
+    }
+}
+
+/*
+ * Takes on the downgrades and invalidations the homes sent a core at the
+ * last barrier, in order of home: those of one line all come from its home,
+ * in the order it applied the accesses
+ */
+static void
+receive_actions(APEX_System_Core *core)
+{
+    APEX_System *system = core->system;
+    APEX_Cache *l1d = &core->cpu->l1d;
+    const APEX_System_Message *message;
+    APEX_System_Queue *queue;
+    uint64_t homes;
+    int way;
+
+    if (!__atomic_load_n(&core->pending, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    homes = __atomic_exchange_n(&core->pending, 0, __ATOMIC_ACQUIRE);
+    for (; homes; homes &= homes - 1)
+    {
+        queue = &system->actions[__builtin_ctzll(homes) * system->num_cores
+                                 + core->id];
+        for (; (message = peek(queue)); pop(queue))
+        {
+            if (message->kind == APEX_MSG_DOWNGRADE)
+            {
+                APEX_cache_downgrade(l1d, message->address, FALSE);
+            }
+            else if (message->kind == APEX_MSG_RESTORE)
+            {
+                restore_line(core, message->address, message->value);
+            }
+            else
+            {
+                way = APEX_cache_downgrade(l1d, message->address, TRUE);
+                if (way >= 0)
+                {
+                    core->cpu->stats.coherence_invalidations++;
+                    if (lose_line(core, message->address, way))
+                    {
+                        __atomic_store_n(&system->core_failed, TRUE,
+                                         __ATOMIC_RELAXED);
+                    }
+                }
+            }
+        }
+    }
+    core->lost_count = 0;
+}
+
+/* Sends a downgrade, invalidation or restore of line from home h to core c.
+ * Returns 0 on success. */
+static int
+send_action(APEX_System *system, int h, int c, int kind, int line, int write)
+{
+    return send(&system->actions[h * system->num_cores + c],
+                &system->cores[c].pending, (uint64_t)1 << h, 0, kind, line,
+                write);
+}
+
+/* Returns TRUE if core c holds the line of an entry, as the messages
+ * applied so far this quantum leave it */
+static int
+has_copy(const APEX_System *system, APEX_Directory_Entry *entry, int c)
+{
+    const uint64_t bit = (uint64_t)1 << c;
+
+    if (!(entry->probed & bit))
+    {
+        entry->probed |= bit;
+        entry->present |= holds(&system->cores[c], entry->line) ? bit : 0;
+    }
+    return (entry->present & bit) != 0;
+}
+
+/*
+ * Applies a message of core c at home h, of quantum, to data memory or the
+ * directory. Returns 0 on success.
+ */
+static int
+apply_request(APEX_System *system, int h, int c,
+              const APEX_System_Message *message, long long quantum)
+{
+    APEX_Directory_Entry *entry;
+    const uint64_t bit = (uint64_t)1 << c;
+    const int write = message->kind == APEX_MSG_WRITE;
+    uint64_t others;
+    int other;
+
+    if (message->kind == APEX_MSG_STORE)
+    {
+        return APEX_memory_write(&system->memory, message->address,
+                                 message->value);
+    }
+
+    entry = directory_entry(&system->homes[h], message->address);
+    if (!entry)
+    {
+        return -1;
+    }
+    if (entry->quantum != quantum)
+    {
+        entry->quantum = quantum;
+        entry->probed = entry->present = entry->lost = 0;
+    }
+
+    if (!has_copy(system, entry, c) && (entry->lost & bit))
+    {
+        entry->present |= bit;
+        if (send_action(system, h, c, APEX_MSG_RESTORE, entry->line, write))
+        {
+            return -1;
+        }
+    }
+
+    /* Drop the cores which no longer hold it */
+    for (others = entry->sharers; others; others &= others - 1)
+    {
+        other = __builtin_ctzll(others);
+        if (!has_copy(system, entry, other))
+        {
+            entry->sharers &= ~((uint64_t)1 << other);
+        }
+    }
+    if (entry->owner >= 0 && !(entry->sharers >> entry->owner & 1))
+    {
+        entry->owner = -1;
+    }
+
+    if (!write)
+    {
+        /* The owner keeps a Shared copy */
+        if (entry->owner >= 0 && entry->owner != c)
+        {
+            if (send_action(system, h, entry->owner, APEX_MSG_DOWNGRADE,
+                            entry->line, FALSE))
+            {
+                return -1;
+            }
+            entry->owner = -1;
+        }
+    }
+    else
+    {
+        for (others = entry->sharers & ~bit; others; others &= others - 1)
+        {
+            other = __builtin_ctzll(others);
+            if (send_action(system, h, other, APEX_MSG_INVALIDATE,
+                            entry->line, FALSE))
+            {
+                return -1;
+            }
+            entry->present &= ~((uint64_t)1 << other);
+            entry->lost |= (uint64_t)1 << other;
+        }
+        entry->sharers &= bit;
+        entry->owner = -1;
+    }
+
+    /* The core may have evicted the line again since */
+    if (has_copy(system, entry, c))
+    {
+        entry->sharers |= bit;
+        entry->owner = write ? c : entry->owner;
+    }
+    return 0;
+}
+
+/* Orders a message at clock from core c before those of later clocks and
+ * of later cores at the same clock */
+static uint64_t
+message_key(long long clock, int c)
+{
+    return (uint64_t)clock * APEX_SYSTEM_MAX_CORES + c;
+}
+
+/* Restores a heap of count keys whose first may be out of order */
+static void
+sift_down(uint64_t *heap, int count)
+{
+    const uint64_t key = heap[0];
+    int i = 0, child;
+
+    while ((child = 2 * i + 1) < count)
+    {
+        if (child + 1 < count && heap[child + 1] < heap[child])
+        {
+            child++;
+        }
+        if (key <= heap[child])
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = key;
+}
+
+/* Adds key to a heap of count keys */
+static void
+sift_up(uint64_t *heap, int count, uint64_t key)
+{
+    int i = count;
+
+    while (i && heap[(i - 1) / 2] > key)
+    {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = key;
+}
+
+/*
+ * Applies the messages the cores sent home h during quantum, in order of
+ * clock, then core, taking them from a heap of every core's first one
+ */
+static void
+apply_home(APEX_System *system, int h, long long quantum)
+{
+    APEX_System_Home *home = &system->homes[h];
+    uint64_t heap[APEX_SYSTEM_MAX_CORES], cores;
+    const APEX_System_Message *message;
+    APEX_System_Queue *queue;
+    int count = 0, c;
+
+    if (!__atomic_load_n(&home->pending, __ATOMIC_RELAXED))
+    {
+        return;
+    }
+    cores = __atomic_exchange_n(&home->pending, 0, __ATOMIC_ACQUIRE);
+    for (; cores; cores &= cores - 1)
+    {
+        c = __builtin_ctzll(cores);
+        message = peek(&system->requests[c * system->num_cores + h]);
+        if (message)
+        {
+            sift_up(heap, count++, message_key(message->clock, c));
+        }
+    }
+
+    while (count)
+    {
+        c = heap[0] % APEX_SYSTEM_MAX_CORES;
+        queue = &system->requests[c * system->num_cores + h];
+        if (apply_request(system, h, c, peek(queue), quantum))
+        {
+            __atomic_store_n(&system->home_failed, TRUE, __ATOMIC_RELAXED);
+        }
+        pop(queue);
+
+        message = peek(queue);
+        heap[0] = message ? message_key(message->clock, c) : heap[--count];
+        sift_down(heap, count);
+    }
+}
+
+/*
+ * Waits for every thread at a sense reversing barrier: the last to arrive
+ * flips the sense of the system to the thread's own. The others poll it,
+ * yielding their processor now and then in case the host runs more threads
+ * than it has.
+ */
+static void
+wait_barrier(APEX_System *system, int *sense)
+{
+    int spins = 0;
+
+    *sense = !*sense;
+    if (__atomic_add_fetch(&system->barrier.arrived, 1, __ATOMIC_ACQ_REL)
+        == system->num_threads)
+    {
+        __atomic_store_n(&system->barrier.arrived, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&system->barrier.sense, *sense, __ATOMIC_RELEASE);
+        return;
+    }
+    while (__atomic_load_n(&system->barrier.sense, __ATOMIC_ACQUIRE) != *sense)
+    {
+        if (++spins == APEX_SYSTEM_SPINS)
+        {
+            sched_yield();
+            spins = 0;
+        }
+    }
+}
+
+/* Takes on a core's messages and runs it to the end of the quantum */
+static void
+run_core(APEX_System_Core *core, long long end)
+{
+    APEX_CPU *cpu = core->cpu;
+
+    receive_actions(core);
+    if (core->stored_count)
+    {
+        memset(core->stored, -1, (core->stored_mask + 1) * sizeof(int));
+        core->stored_count = 0;
+    }
+    if (!cpu->halted)
+    {
+        cpu->cycle = end;
+        APEX_cpu_run(cpu);
+        if (cpu->halted)
+        {
+            __atomic_add_fetch(&core->system->halted, 1, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+ * Runs quanta on thread id, its cores and then its homes between barriers,
+ * until every core halts, one fails or the cycle limit. Every thread comes
+ * to the same end, reading what the cores and homes set before the last
+ * barrier.
+ */
+static void
+run_thread(APEX_System *system, int id)
+{
+    const int n = system->num_cores, threads = system->num_threads;
+    long long start = 0, quantum = 0, end;
+    int sense = FALSE, running = TRUE, c;
+
+    while (running)
+    {
+        end = system->cycles - start > system->quantum
+                  ? start + system->quantum
+                  : system->cycles;
+        for (c = id; c < n; c += threads)
+        {
+            run_core(&system->cores[c], end);
+        }
+        wait_barrier(system, &sense);
+
+        running = end < system->cycles
+                  && __atomic_load_n(&system->halted, __ATOMIC_RELAXED) < n
+                  && !__atomic_load_n(&system->core_failed, __ATOMIC_RELAXED);
+
+        quantum++;
+        for (c = id; c < n; c += threads)
+        {
+            apply_home(system, c, quantum);
+        }
+        wait_barrier(system, &sense);
+
+        running = running
+                  && !__atomic_load_n(&system->home_failed, __ATOMIC_RELAXED);
+        start = end;
+    }
+
+    if (!id)
+    {
+        system->clock = start;
+        system->quanta = quantum;
+    }
+}
+
+static void *
+worker_main(void *arg)
+{
+    APEX_System_Worker *worker = arg;
+
+    /* The threads are known once all have been started */
+    while (!__atomic_load_n(&worker->system->started, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+    run_thread(worker->system, worker->id);
+    return NULL;
+}
+
+/*
+ * Runs quanta until every core halts or the cycle limit, the first thread
+ * being the calling one, and has the cores take on the last messages sent
+ * them. Runs on the threads started if the host cannot start them all.
+ * Returns 0 on success.
+ */
+static int
+step(APEX_System *system)
+{
+    APEX_System_Worker *workers;
+    pthread_t *threads;
+    int c;
+
+    workers = calloc(system->num_threads, sizeof(APEX_System_Worker));
+    threads = calloc(system->num_threads, sizeof(pthread_t));
+    if (!workers || !threads)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate %d threads\n",
+                system->num_threads);
+        free(workers);
+        free(threads);
+        return -1;
+    }
+
+    for (c = 1; c < system->num_threads; ++c)
+    {
+        workers[c].system = system;
+        workers[c].id = c;
+        if (pthread_create(&threads[c], NULL, worker_main, &workers[c]))
+        {
+            system->num_threads = c;
+        }
+    }
+    __atomic_store_n(&system->started, TRUE, __ATOMIC_RELEASE);
+    run_thread(system, 0);
+    for (c = 1; c < system->num_threads; ++c)
+    {
+        pthread_join(threads[c], NULL);
+    }
+    free(workers);
+    free(threads);
+
+    for (c = 0; c < system->num_cores; ++c)
+    {
+        receive_actions(&system->cores[c]);
+    }
+    if (system->core_failed || system->home_failed)
+    {
+        fprintf(stderr, "APEX_Error: Unable to apply the accesses of the "
+                        "quantum ending at cycle %lld\n", system->clock);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Adds a core running filename to the system, with options. Returns 0 on
+ * success.
+ */
+static int
+add_core(APEX_System *system, const char *filename,
+         const APEX_Options *options)
+{
+    APEX_System_Core *core = &system->cores[system->num_cores];
+    APEX_CPU *cpu;
+    int i;
+
+    if (APEX_checkpoint_probe(filename))
+    {
+        fprintf(stderr, "APEX_Error: %s is a checkpoint, cores of a system "
+                        "start from a program\n", filename);
+        return -1;
+    }
+
+    cpu = APEX_cpu_init(filename, "simulate", system->cycles,
+                        options->data_memory_size);
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize core %d, %s\n",
+                system->num_cores, filename);
+        return -1;
+    }
+    memset(core, 0, sizeof(*core));
+    core->cpu = cpu;
+    core->system = system;
+    core->id = system->num_cores++;
+    core->filename = strdup(filename);
+    cpu->quiet = TRUE;
+    if (!core->filename || APEX_cpu_set_options(cpu, options))
+    {
+        return -1;
+    }
+
+    if (!cpu->l1d.config.size
+        || cpu->l1d.config.line != system->cores[0].cpu->l1d.config.line
+        || cpu->prefetcher.kind != APEX_PREFETCH_NONE)
+    {
+        fprintf(stderr, "APEX_Error: Cores of a system take L1 data caches "
+                        "of one line size and no data prefetcher, see %s\n",
+                filename);
+        return -1;
+    }
+
+    /* The first core's program gives the shared memory its data */
+    for (i = 0; core->id && i < cpu->data_memory.num_pages; ++i)
+    {
+        if (cpu->data_memory.pages[i])
+        {
+            fprintf(stderr, "APEX_Error: %s has data memory, only the first "
+                            "core's program may\n", filename);
+            return -1;
+        }
+    }
+    if (!core->id)
+    {
+        system->memory = cpu->data_memory;
+        system->page_line_shift = APEX_PAGE_SHIFT - cpu->l1d.line_shift;
+        if (APEX_memory_init(&cpu->data_memory, system->memory.size))
+        {
+            return -1;
+        }
+    }
+
+    core->lost_capacity = 16;
+    core->lost = malloc(core->lost_capacity * sizeof(APEX_System_Lost));
+    if (!core->lost || alloc_stored(core, 64))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate core %d\n", core->id);
+        return -1;
+    }
+    cpu->system = core;
+    return 0;
+}
+
+/*
+ * Reads the system file and adds its cores, each with the options of the
+ * command line followed by those of its line, which leave the data memory
+ * and the system itself alone. Returns 0 on success.
+ */
+static int
+read_system(APEX_System *system, const char *filename,
+            const APEX_Options *options)
+{
+    FILE *fp;
+    char *line = NULL;
+    size_t len = 0;
+    int line_number = 0, failed = FALSE;
+    char path[4096], option[64];
+
+    fp = fopen(filename, "r");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open system %s\n", filename);
+        return -1;
+    }
+
+    while (!failed && getline(&line, &len, fp) != -1)
+    {
+        APEX_Options core_options = *options, own;
+        int valid = TRUE, offset = 0, length;
+
+        line_number++;
+        if (sscanf(line, "%4095s%n", path, &offset) != 1 || path[0] == '#')
+        {
+            continue;
+        }
+
+        APEX_options_init(&own);
+        while (valid && sscanf(line + offset, " %63s%n", option, &length) == 1)
+        {
+            valid = APEX_parse_option(option, &core_options) == 0
+                    && APEX_parse_option(option, &own) == 0
+                    && !own.data_memory_size && !own.checkpoint
+                    && own.coherence < 0 && !own.c2c_latency
+                    && !own.quantum && !own.threads;
+            offset += length;
+        }
+
+        if (!valid || system->num_cores == APEX_SYSTEM_MAX_CORES)
+        {
+            fprintf(stderr,
+                    "APEX_Error: Invalid core on line %d of %s, expected at "
+                    "most %d lines of <input_file> [<options>], the options "
+                    "of a core and not mem=, checkpoint=, coherence=, c2c=, "
+                    "quantum= or threads=\n",
+                    line_number, filename, APEX_SYSTEM_MAX_CORES);
+            failed = TRUE;
+        }
+        else
+        {
+            failed = add_core(system, path, &core_options) != 0;
+        }
+    }
+
+    free(line);
+    fclose(fp);
+    if (!failed && !system->num_cores)
+    {
+        fprintf(stderr, "APEX_Error: %s has no cores\n", filename);
+        failed = TRUE;
+    }
+    return failed ? -1 : 0;
+}
+
+/* Frees the system and its cores, giving each the final data memory and
+ * reporting it first if report is set */
+static void
+free_system(APEX_System *system, int report)
+{
+    APEX_System_Core *core;
+    int c;
+
+    for (c = 0; c < system->num_cores; ++c)
+    {
+        core = &system->cores[c];
+        if (report)
+        {
+            printf("\nAPEX_System: Core %d %s, cycles = %lld "
+                   "instructions = %lld%s\n",
+                   c, core->filename, core->cpu->clock,
+                   core->cpu->insn_completed,
+                   core->cpu->fault ? " (fault)" : "");
+            APEX_memory_free(&core->cpu->data_memory);
+            APEX_memory_share(&core->cpu->data_memory, &system->memory);
+            core->cpu->quiet = FALSE;
+        }
+        APEX_cpu_stop(core->cpu);
+        free(core->filename);
+        free(core->lost);
+        free(core->stored);
+        free(core->stored_values);
+    }
+    for (c = 0; system->requests && system->actions
+                && c < system->num_cores * system->num_cores;
+         ++c)
+    {
+        free(system->requests[c].messages);
+        free(system->actions[c].messages);
+    }
+    for (c = 0; system->homes && c < system->num_cores; ++c)
+    {
+        free(system->homes[c].directory);
+    }
+    APEX_memory_free(&system->memory);
+    free(system->requests);
+    free(system->actions);
+    free(system->homes);
+    free(system->page_homes);
+    free(system->cores);
+}
+
+/* Sets up the homes of the cores and the queues between them. Returns 0 on
+ * success. */
+static int
+alloc_homes(APEX_System *system)
+{
+    const int n = system->num_cores;
+    int h, page;
+
+    system->homes = aligned_alloc(APEX_SYSTEM_CACHE_LINE,
+                                  n * sizeof(APEX_System_Home));
+    system->requests = calloc(n * n, sizeof(APEX_System_Queue));
+    system->actions = calloc(n * n, sizeof(APEX_System_Queue));
+    system->page_homes = malloc(system->memory.num_pages + 1);
+    if (!system->homes || !system->requests || !system->actions
+        || !system->page_homes)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate the homes of %d "
+                        "cores\n", n);
+        return -1;
+    }
+
+    memset(system->homes, 0, n * sizeof(APEX_System_Home));
+    for (h = 0; h < n; ++h)
+    {
+        system->cores[h].requests = &system->requests[h * n];
+        if (alloc_directory(&system->homes[h], 256))
+        {
+            return -1;
+        }
+    }
+    for (page = 0; page < system->memory.num_pages; ++page)
+    {
+        system->page_homes[page] = page % n;
+    }
+    return 0;
+}
+
+/* Writes the configuration and totals of a finished system as a JSON
+ * object */
+static void
+print_system_stats(FILE *fp, const APEX_System *system, long long cycles)
+{
+    long long insns = 0, transfers = 0, upgrades = 0, invalidations = 0;
+    int c;
+
+    for (c = 0; c < system->num_cores; ++c)
+    {
+        const APEX_CPU *cpu = system->cores[c].cpu;
+
+        insns += cpu->insn_completed;
+        transfers += cpu->stats.coherence_transfers;
+        upgrades += cpu->stats.coherence_upgrades;
+        invalidations += cpu->stats.coherence_invalidations;
+    }
+
+    fprintf(fp, "{\"cores\":%d,\"cycles\":%lld,\"instructions\":%lld,"
+                "\"ipc\":%.3f,\"protocol\":\"%s\",\"c2c_latency\":%d,"
+                "\"quantum\":%d,\"quanta\":%lld,\"threads\":%d,"
+                "\"transfers\":%lld,\"upgrades\":%lld,"
+                "\"invalidations\":%lld}",
+            system->num_cores, cycles, insns,
+            cycles ? (double)insns / cycles : 0.0,
+            APEX_coherence_name(system->protocol), system->c2c_latency,
+            system->quantum, system->quanta, system->num_threads, transfers,
+            upgrades, invalidations);
+}
+
+/*
+ * Runs the cores of a system file for at most cycles cycles, under the
+ * coherence protocol, c2c latency, quantum and threads of options, and
+ * reports every core. Returns 0 on success.
+ */
+int
+APEX_system_run(const char *system_file, long long cycles,
+                const APEX_Options *options)
+{
+    APEX_System system;
+    long long clock = 0;
+    long processors;
+    int c, failed;
+
+    memset(&system, 0, sizeof(system));
+    system.protocol = options->coherence >= 0 ? options->coherence
+                                              : APEX_COHERENCE_MESI;
+    system.c2c_latency = options->c2c_latency ? options->c2c_latency
+                                              : APEX_SYSTEM_C2C_LATENCY;
+    system.quantum = options->quantum ? options->quantum
+                                      : system.c2c_latency;
+    system.num_threads = options->threads;
+    system.cycles = cycles;
+
+    if (cycles <= 0 || options->checkpoint
+        || system.c2c_latency > APEX_CACHE_MAX_LATENCY)
+    {
+        fprintf(stderr, "APEX_Error: Systems run a positive number of cycles, "
+                        "with c2c latencies of at most %d cycles and no "
+                        "checkpoint\n", APEX_CACHE_MAX_LATENCY);
+        return -1;
+    }
+
+    system.cores = calloc(APEX_SYSTEM_MAX_CORES, sizeof(APEX_System_Core));
+    if (!system.cores || read_system(&system, system_file, options)
+        || alloc_homes(&system))
+    {
+        free_system(&system, FALSE);
+        return -1;
+    }
+
+    if (!system.num_threads)
+    {
+        processors = sysconf(_SC_NPROCESSORS_ONLN);
+        system.num_threads = processors > 0 ? (int)processors : 1;
+    }
+    if (system.num_threads > system.num_cores)
+    {
+        system.num_threads = system.num_cores;
+    }
+
+    failed = step(&system);
+
+    for (c = 0; c < system.num_cores; ++c)
+    {
+        if (system.cores[c].cpu->clock > clock)
+        {
+            clock = system.cores[c].cpu->clock;
+        }
+    }
+    if (!failed)
+    {
+        printf("APEX_System: Simulation Complete, cycles = %lld cores = %d\n",
+               clock, system.num_cores);
+        fprintf(stderr, "APEX_System_Stats: ");
+        print_system_stats(stderr, &system, clock);
+        fprintf(stderr, "\n");
+    }
+    free_system(&system, !failed);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,554 @@
+/*
+ * apex_trace.c
+ * Contains the buffered pipeline trace used by display mode and trace files
+ *
+ * Every cycle the pipeline records which stages hold an instruction, their PC
+ * and whether they are stalled into a preallocated ring of fixed size records,
+ * with room for the widest group a stage of the traced pipeline holds.
+ * A latch always holds the instruction at its PC, so a record only needs the
+ * PCs, instructions are looked up in code memory when the trace is rendered.
+ * When the ring fills up it is flushed in one block, either rendered as the
+ * human-readable display output or written out as is to a binary trace file.
+ *
+ * A binary trace file is a header, a copy of code memory and then the
+ * records, in host byte order. It is rendered offline with APEX_trace_render.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_isa.h"
+#include "apex_macros.h"
+
+#define APEX_TRACE_MAGIC "APXT"
+
+/* Bump whenever the layout of the header or of a record changes */
+#define APEX_TRACE_VERSION 3
+
+/* Number of cycles buffered before a flush */
+#define APEX_TRACE_RING_SIZE 4096
+
+/* Size of the text staging buffer and the most a single cycle can print */
+#define APEX_TRACE_TEXT_SIZE (256 * 1024)
+#define APEX_TRACE_TEXT_CYCLE 2048
+
+typedef struct APEX_Trace_Header
+{
+    char magic[4];             /* APEX_TRACE_MAGIC */
+    uint32_t version;          /* APEX_TRACE_VERSION */
+    uint32_t record_size;      /* record_size(width) */
+    uint32_t code_memory_size; /* Number of instructions following the header */
+    uint32_t width;            /* Instructions per stage a record holds */
+} APEX_Trace_Header;
+
+/* Stage occupancy at the end of one cycle. Each stage has width slots, the
+ * instructions of its group in order, slot s of a stage is bit and PC
+ * stage * width + s. */
+typedef struct APEX_Trace_Record
+{
+    int64_t clock;
+    uint32_t valid;  /* Bit per slot, set if the slot is printed */
+    uint32_t stall;  /* Bit per slot, set if the slot is stalled */
+    int pc[];
+} APEX_Trace_Record;
+
+struct APEX_Trace
+{
+    FILE *fp;
+    int format;                          /* APEX_TRACE_TEXT or APEX_TRACE_BINARY */
+    int width;                           /* Slots per stage */
+    size_t record_size;
+    const APEX_Instruction *code_memory; /* Looked up by PC when rendering */
+    int code_memory_size;
+    int count;                           /* Complete records, record count is
+                                            the cycle being recorded */
+    char *ring;
+    char *text;                          /* Staging buffer of the text format */
+};
+
+_Static_assert(sizeof(APEX_Trace_Record) == 16,
+               "APEX_Trace_Record layout is part of the trace format");
+_Static_assert(APEX_TRACE_STAGES * APEX_MAX_WIDTH <= 32,
+               "Slot bits must fit in 32 bits");
+
+/* Bytes of a record of the given width */
+static size_t
+record_size(int width)
+{
+    /* Rounded up to keep the clock of every record aligned */
+    return (sizeof(APEX_Trace_Record) + APEX_TRACE_STAGES * width * sizeof(int)
+            + 7) & ~(size_t)7;
+}
+
+/* Returns record i of a ring or block of records */
+static APEX_Trace_Record *
+record_at(char *records, size_t size, int i)
+{
+    return (APEX_Trace_Record *)(records + i * size);
+}
+
+/* Stage names padded the way the display output always printed them */
+static const char *const stage_prefixes[APEX_TRACE_STAGES] = {
+    [APEX_TRACE_WRITEBACK] = "Writeback      : pc(",
+    [APEX_TRACE_MEMORY] = "Memory         : pc(",
+    [APEX_TRACE_EXECUTE] = "Execute        : pc(",
+    [APEX_TRACE_DECODE] = "Decode/RF      : pc(",
+    [APEX_TRACE_FETCH] = "Fetch          : pc(",
+};
+
+static char *
+put_str(char *out, const char *str)
+{
+    while (*str)
+    {
+        *out++ = *str++;
+    }
+    return out;
+}
+
+static char *
+put_int(char *out, long long value)
+{
+    char digits[20];
+    unsigned long long v = value;
+    int n = 0;
+
+    if (value < 0)
+    {
+        *out++ = '-';
+        v = -v;
+    }
+
+    do
+    {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    while (n)
+    {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+static char *
+put_reg(char *out, int reg)
+{
+    *out++ = ',';
+    *out++ = 'R';
+    return put_int(out, reg);
+}
+
+static char *
+put_imm(char *out, int imm)
+{
+    *out++ = ',';
+    *out++ = '#';
+    return put_int(out, imm);
+}
+
+/*
+ * Formats an instruction like the display output always did, its operands in
+ * the order apex_isa lists them. Undefined opcodes print nothing.
+ */
+static char *
+put_instruction(char *out, const APEX_Instruction *ins)
+{
+    const APEX_Opcode *op = &apex_isa[ins->opcode];
+    const char *operand;
+
+    if (!op->name)
+    {
+        return out;
+    }
+
+    out = put_str(out, op->name);
+    for (operand = op->operands; *operand; ++operand)
+    {
+        switch (*operand)
+        {
+            case 'd':
+                out = put_reg(out, ins->rd);
+                break;
+            case 's':
+                out = put_reg(out, ins->rs1);
+                break;
+            case 't':
+                out = put_reg(out, ins->rs2);
+                break;
+            case 'i':
+                out = put_imm(out, ins->imm);
+                break;
+            default:
+                *out++ = *operand;
+                break;
+        }
+    }
+    return out;
+}
+
+/* Formats one cycle: the clock banner and every printed stage, a line per
+ * instruction of its group */
+static char *
+put_record(char *out, const APEX_Trace_Record *record, int width,
+           const APEX_Instruction *code_memory, int code_memory_size)
+{
+    const uint32_t group = (1u << width) - 1;
+    uint32_t valid;
+    int stage, slot, index;
+
+    out = put_str(out, "--------------------------------------------\n"
+                       "Clock Cycle #: ");
+    out = put_int(out, record->clock);
+    out = put_str(out, "\n--------------------------------------------\n");
+
+    for (stage = 0; stage < APEX_TRACE_STAGES; ++stage)
+    {
+        /* Only the occupied slots of the stage */
+        valid = record->valid & group << stage * width;
+        for (; valid; valid &= valid - 1)
+        {
+            slot = __builtin_ctz(valid);
+            out = put_str(out, stage_prefixes[stage]);
+            out = put_int(out, record->pc[slot]);
+            *out++ = ')';
+            *out++ = ' ';
+
+            /* Code memory index of the PC, nothing is printed outside of it */
+            if (record->pc[slot] >= 4000)
+            {
+                index = (record->pc[slot] - 4000) / 4;
+                if (index < code_memory_size)
+                {
+                    out = put_instruction(out, &code_memory[index]);
+                }
+            }
+            *out++ = '\n';
+        }
+    }
+    return out;
+}
+
+/* Renders records as text in blocks of at most APEX_TRACE_TEXT_SIZE bytes */
+static int
+write_text(FILE *fp, char *text, char *records, int count, int width,
+           const APEX_Instruction *code_memory, int code_memory_size)
+{
+    const size_t size = record_size(width);
+    char *out = text;
+    int i;
+
+    for (i = 0; i < count; ++i)
+    {
+        if (out - text > APEX_TRACE_TEXT_SIZE - APEX_TRACE_TEXT_CYCLE)
+        {
+            if (fwrite(text, 1, out - text, fp) != (size_t)(out - text))
+            {
+                return -1;
+            }
+            out = text;
+        }
+        out = put_record(out, record_at(records, size, i), width, code_memory,
+                         code_memory_size);
+    }
+
+    if (fwrite(text, 1, out - text, fp) != (size_t)(out - text))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Starts a trace of a program run up to width instructions per stage. Text
+ * traces go to stdout if filename is NULL, binary traces start with the
+ * header and a copy of code memory. Returns NULL on failure.
+ */
+APEX_Trace *
+APEX_trace_open(const char *filename, int format, int width,
+                const APEX_Instruction *code_memory, int code_memory_size)
+{
+    APEX_Trace_Header header;
+    APEX_Trace *trace;
+
+    trace = calloc(1, sizeof(APEX_Trace));
+    if (!trace)
+    {
+        return NULL;
+    }
+
+    trace->format = format;
+    trace->width = width;
+    trace->record_size = record_size(width);
+    trace->code_memory = code_memory;
+    trace->code_memory_size = code_memory_size;
+    /* One more record than is flushed at once, the one being filled */
+    trace->ring = calloc(APEX_TRACE_RING_SIZE + 1, trace->record_size);
+    if (format == APEX_TRACE_TEXT)
+    {
+        trace->text = malloc(APEX_TRACE_TEXT_SIZE);
+    }
+
+    if (!trace->ring || (format == APEX_TRACE_TEXT && !trace->text))
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate trace buffers\n");
+        free(trace->text);
+        free(trace->ring);
+        free(trace);
+        return NULL;
+    }
+
+    trace->fp = filename ? fopen(filename, "wb") : stdout;
+    if (!trace->fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to create %s\n", filename);
+        free(trace->text);
+        free(trace->ring);
+        free(trace);
+        return NULL;
+    }
+
+    if (format == APEX_TRACE_BINARY)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, APEX_TRACE_MAGIC, sizeof(header.magic));
+        header.version = APEX_TRACE_VERSION;
+        header.record_size = trace->record_size;
+        header.code_memory_size = code_memory_size;
+        header.width = width;
+        fwrite(&header, sizeof(header), 1, trace->fp);
+        fwrite(code_memory, sizeof(APEX_Instruction), code_memory_size,
+               trace->fp);
+    }
+    return trace;
+}
+
+/*
+ * Changes the slots per stage of a trace between cycles, the records flushed
+ * so far keep theirs. Binary traces hold one width. Returns 0 on success.
+ */
+int
+APEX_trace_set_width(APEX_Trace *trace, int width)
+{
+    char *ring;
+
+    if (!trace || width == trace->width)
+    {
+        return 0;
+    }
+
+    if (trace->format == APEX_TRACE_BINARY)
+    {
+        fprintf(stderr, "APEX_Error: Unable to change the width of a binary "
+                        "trace\n");
+        return -1;
+    }
+
+    ring = calloc(APEX_TRACE_RING_SIZE + 1, record_size(width));
+    if (!ring)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate trace buffers\n");
+        return -1;
+    }
+
+    APEX_trace_flush(trace);
+    free(trace->ring);
+    trace->ring = ring;
+    trace->width = width;
+    trace->record_size = record_size(width);
+    return 0;
+}
+
+/*
+ * Records slot of a stage of the current cycle, the position in its group,
+ * as occupied by the instruction at pc
+ */
+void
+APEX_trace_stage(APEX_Trace *trace, int stage, int slot, int pc, int stall)
+{
+    APEX_Trace_Record *record;
+
+    if (!trace)
+    {
+        return;
+    }
+
+    record = record_at(trace->ring, trace->record_size, trace->count);
+    slot += stage * trace->width;
+    record->valid |= 1u << slot;
+    record->stall |= (stall ? 1u : 0u) << slot;
+    record->pc[slot] = pc;
+}
+
+/*
+ * Completes the record of the current cycle, flushing the ring once it fills
+ */
+void
+APEX_trace_end_cycle(APEX_Trace *trace, long long clock)
+{
+    APEX_Trace_Record *record;
+
+    if (!trace)
+    {
+        return;
+    }
+
+    record_at(trace->ring, trace->record_size, trace->count)->clock = clock;
+    if (++trace->count == APEX_TRACE_RING_SIZE)
+    {
+        APEX_trace_flush(trace);
+    }
+
+    record = record_at(trace->ring, trace->record_size, trace->count);
+    record->valid = 0;
+    record->stall = 0;
+}
+
+/*
+ * Writes out every complete record in the ring
+ */
+void
+APEX_trace_flush(APEX_Trace *trace)
+{
+    int failed;
+
+    if (!trace || !trace->count)
+    {
+        return;
+    }
+
+    if (trace->format == APEX_TRACE_TEXT)
+    {
+        failed = write_text(trace->fp, trace->text, trace->ring, trace->count,
+                            trace->width, trace->code_memory,
+                            trace->code_memory_size);
+    }
+    else
+    {
+        failed = fwrite(trace->ring, trace->record_size, trace->count,
+                        trace->fp) != (size_t)trace->count;
+    }
+
+    if (failed)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write trace\n");
+    }
+
+    /* The record being filled moves to the front of the ring */
+    memcpy(trace->ring,
+           record_at(trace->ring, trace->record_size, trace->count),
+           trace->record_size);
+    trace->count = 0;
+}
+
+/*
+ * Flushes and closes a trace
+ */
+void
+APEX_trace_close(APEX_Trace *trace)
+{
+    if (!trace)
+    {
+        return;
+    }
+
+    APEX_trace_flush(trace);
+    if (trace->fp != stdout && fclose(trace->fp) != 0)
+    {
+        fprintf(stderr, "APEX_Error: Unable to write trace\n");
+    }
+    free(trace->text);
+    free(trace->ring);
+    free(trace);
+}
+
+/*
+ * Renders a binary trace file in the display format to output_file, or stdout
+ * if NULL. Returns 0 on success.
+ */
+int
+APEX_trace_render(const char *trace_file, const char *output_file)
+{
+    APEX_Trace_Header header;
+    APEX_Instruction *code_memory = NULL;
+    char *records = NULL;
+    char *text = NULL;
+    FILE *fp, *out = stdout;
+    size_t count;
+    int ret = -1;
+
+    fp = fopen(trace_file, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "APEX_Error: Unable to open trace %s\n", trace_file);
+        return -1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1
+        || memcmp(header.magic, APEX_TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != APEX_TRACE_VERSION || header.width < 1
+        || header.width > APEX_MAX_WIDTH
+        || header.record_size != record_size(header.width))
+    {
+        fprintf(stderr, "APEX_Error: %s is not a version %d trace\n",
+                trace_file, APEX_TRACE_VERSION);
+        fclose(fp);
+        return -1;
+    }
+
+    code_memory = malloc((header.code_memory_size + 1)
+                         * sizeof(APEX_Instruction));
+    records = malloc(APEX_TRACE_RING_SIZE * header.record_size);
+    text = malloc(APEX_TRACE_TEXT_SIZE);
+    if (!code_memory || !records || !text)
+    {
+        fprintf(stderr, "APEX_Error: Unable to allocate trace buffers\n");
+        goto done;
+    }
+
+    if (fread(code_memory, sizeof(APEX_Instruction), header.code_memory_size,
+              fp) != header.code_memory_size)
+    {
+        fprintf(stderr, "APEX_Error: %s is truncated\n", trace_file);
+        goto done;
+    }
+
+    if (output_file)
+    {
+        out = fopen(output_file, "w");
+        if (!out)
+        {
+            fprintf(stderr, "APEX_Error: Unable to create %s\n", output_file);
+            out = stdout;
+            goto done;
+        }
+    }
+
+    ret = 0;
+    while ((count = fread(records, header.record_size, APEX_TRACE_RING_SIZE,
+                          fp)) > 0)
+    {
+        if (write_text(out, text, records, count, header.width, code_memory,
+                       header.code_memory_size))
+        {
+            fprintf(stderr, "APEX_Error: Unable to write trace\n");
+            ret = -1;
+            break;
+        }
+    }
+
+    if (out != stdout && fclose(out) != 0)
+    {
+        ret = -1;
+    }
+
+done:
+    free(text);
+    free(records);
+    free(code_memory);
+    fclose(fp);
+    return ret;
+}
@@ -0,0 +1,394 @@
+/*
+ * file_parser.c
+ * Contains functions to parse input file and create code memory. Instructions
+ * are parsed by their row of apex_isa.h, which is where new ones are added
+ *
+ * The input file is memory mapped and parsed in a single pass, tokenizing in
+ * place without copying lines or tokens.
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "apex_cpu.h"
+#include "apex_isa.h"
+#include "apex_macros.h"
+
+/* Initial number of instructions in code memory, doubled as it fills up */
+#define CODE_MEMORY_INITIAL_SIZE 1024
+
+/* Cursor over the line being parsed, end points past its last character */
+typedef struct APEX_Line
+{
+    const char *pos;
+    const char *end;
+    int number;
+} APEX_Line;
+
+static int
+is_blank(const char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static void
+skip_blanks(APEX_Line *line)
+{
+    while (line->pos < line->end && is_blank(*line->pos))
+    {
+        line->pos++;
+    }
+}
+
+/*
+ * This function parses an operand like R3 or #-12 at the cursor: the leading
+ * register/immediate marker is skipped and the rest read as a decimal number,
+ * up to the next comma. Numbers too large for an int are read as INT_MAX + 1
+ * or beyond, for the caller to reject. Returns 0 once the line has no
+ * operands left.
+ */
+static int
+get_num_from_line(APEX_Line *line, long long *value)
+{
+    int sign = 1;
+    long long num = 0;
+
+    skip_blanks(line);
+    if (line->pos >= line->end)
+    {
+        return 0;
+    }
+
+    /* Skip R or # */
+    line->pos++;
+    if (line->pos < line->end && (*line->pos == '-' || *line->pos == '+'))
+    {
+        sign = *line->pos == '-' ? -1 : 1;
+        line->pos++;
+    }
+
+    while (line->pos < line->end && *line->pos >= '0' && *line->pos <= '9')
+    {
+        if (num <= INT_MAX)
+        {
+            num = num * 10 + (*line->pos - '0');
+        }
+        line->pos++;
+    }
+
+    /* Move past the separating comma */
+    while (line->pos < line->end && *line->pos != ',')
+    {
+        line->pos++;
+    }
+    if (line->pos < line->end)
+    {
+        line->pos++;
+    }
+
+    *value = sign * num;
+    return 1;
+}
+
+/* Mnemonics of the opcodes in apex_isa, in the order of its rows, which are
+ * sorted by mnemonic for set_opcode_str */
+typedef struct APEX_Mnemonic
+{
+    const char *str;
+    int opcode;
+} APEX_Mnemonic;
+
+#define APEX_MNEMONIC_ROW(opcode, name, operands, unit, alu, cc, branch,     \
+                          effects)                                           \
+    { name, opcode },
+
+static const APEX_Mnemonic mnemonics[] = { APEX_ISA(APEX_MNEMONIC_ROW) };
+
+#define NUM_MNEMONICS ((int)(sizeof(mnemonics) / sizeof(mnemonics[0])))
+
+/* Returns TRUE if the rows of apex_isa are sorted by mnemonic */
+static int
+mnemonics_sorted(void)
+{
+    int i;
+
+    for (i = 1; i < NUM_MNEMONICS; ++i)
+    {
+        if (strcmp(mnemonics[i - 1].str, mnemonics[i].str) >= 0)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*
+ * This function sets the numeric opcode to an instruction based on string
+ * value of the given length, using a binary search of the mnemonics. Returns
+ * -1 for an unknown mnemonic.
+ *
+ * Note : instructions are added to apex_isa.h, see there
+ */
+static int
+set_opcode_str(const char *opcode_str, int len)
+{
+    int low = 0;
+    int high = NUM_MNEMONICS - 1;
+
+    while (low <= high)
+    {
+        int mid = (low + high) / 2;
+        int cmp = strncmp(opcode_str, mnemonics[mid].str, len);
+
+        /* opcode_str is not NUL terminated, a longer mnemonic sorts after it */
+        if (cmp == 0 && mnemonics[mid].str[len] != '\0')
+        {
+            cmp = -1;
+        }
+
+        if (cmp == 0)
+        {
+            return mnemonics[mid].opcode;
+        }
+
+        if (cmp < 0)
+        {
+            high = mid - 1;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * This function returns the mnemonic of a numeric opcode
+ */
+const char *
+get_opcode_str(int opcode)
+{
+    if (opcode < 0 || opcode > 255 || !apex_isa[opcode].name)
+    {
+        return "???";
+    }
+    return apex_isa[opcode].name;
+}
+
+/*
+ * Returns TRUE if an instruction has a defined opcode and its registers lie
+ * within the register file, as every parsed one does. Code memory and latches
+ * read back from images and checkpoints are checked with it before they run.
+ */
+int
+APEX_instruction_valid(int opcode, int rd, int rs1, int rs2)
+{
+    return opcode >= 0 && opcode <= 255 && apex_isa[opcode].name
+           && rd >= 0 && rd < REG_FILE_SIZE && rs1 >= 0 && rs1 < REG_FILE_SIZE
+           && rs2 >= 0 && rs2 < REG_FILE_SIZE;
+}
+
+/*
+ * This function is related to parsing input file, returns -1 if the
+ * instruction on the given line is invalid
+ */
+static int
+create_APEX_instruction(APEX_Instruction *ins, APEX_Line *line)
+{
+    const char *opcode_str;
+    const char *operand;
+    int opcode_len;
+    int opcode;
+    long long value;
+
+    skip_blanks(line);
+    opcode_str = line->pos;
+    while (line->pos < line->end && !is_blank(*line->pos))
+    {
+        line->pos++;
+    }
+    opcode_len = line->pos - opcode_str;
+
+    opcode = set_opcode_str(opcode_str, opcode_len);
+    if (opcode < 0)
+    {
+        fprintf(stderr, "APEX_Error: Invalid opcode \"%.*s\" on line %d\n",
+                opcode_len, opcode_str, line->number);
+        return -1;
+    }
+    ins->opcode = opcode;
+
+    /* Operands are assigned in the order apex_isa lists them, missing ones
+     * are left 0 and extra ones ignored */
+    for (operand = apex_isa[opcode].operands; *operand; ++operand)
+    {
+        if (*operand == ' ')
+        {
+            continue;
+        }
+
+        if (!get_num_from_line(line, &value))
+        {
+            break;
+        }
+
+        if (*operand != 'i' && (value < 0 || value >= REG_FILE_SIZE))
+        {
+            fprintf(stderr, "APEX_Error: Invalid register R%lld on line %d, "
+                            "expected R0 to R%d\n",
+                    value, line->number, REG_FILE_SIZE - 1);
+            return -1;
+        }
+        if (*operand == 'i' && (value < INT_MIN || value > INT_MAX))
+        {
+            fprintf(stderr, "APEX_Error: Immediate #%lld on line %d does not "
+                            "fit in an int\n",
+                    value, line->number);
+            return -1;
+        }
+
+        switch (*operand)
+        {
+            case 'd':
+                ins->rd = value;
+                break;
+            case 's':
+                ins->rs1 = value;
+                break;
+            case 't':
+                ins->rs2 = value;
+                break;
+            case 'i':
+                ins->imm = value;
+                break;
+        }
+    }
+    return 0;
+}
+
+/* Returns TRUE if a line holds nothing but blanks */
+static int
+is_blank_line(const APEX_Line *line)
+{
+    const char *pos = line->pos;
+
+    while (pos < line->end && is_blank(*pos))
+    {
+        pos++;
+    }
+    return pos == line->end;
+}
+
+/*
+ * This function is related to parsing input file. The file is mapped and
+ * scanned once, one instruction per line, growing code memory geometrically.
+ * Blank lines hold no instruction and are skipped.
+ */
+APEX_Instruction *
+create_code_memory(const char *filename, int *size)
+{
+    int fd;
+    struct stat st;
+    const char *file, *file_end, *newline;
+    APEX_Line line;
+    int capacity = CODE_MEMORY_INITIAL_SIZE;
+    int code_memory_size = 0;
+    APEX_Instruction *code_memory, *grown;
+
+    *size = 0;
+    if (!filename)
+    {
+        return NULL;
+    }
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    file = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file == MAP_FAILED)
+    {
+        return NULL;
+    }
+    file_end = file + st.st_size;
+    madvise((void *)file, st.st_size, MADV_SEQUENTIAL);
+
+    code_memory = calloc(capacity, sizeof(APEX_Instruction));
+    if (!code_memory)
+    {
+        munmap((void *)file, st.st_size);
+        return NULL;
+    }
+
+    /* A row added out of order would make some mnemonics unknown */
+    assert(mnemonics_sorted());
+    line.pos = file;
+    line.number = 0;
+    while (line.pos < file_end)
+    {
+        newline = memchr(line.pos, '\n', file_end - line.pos);
+        line.end = newline ? newline : file_end;
+        line.number++;
+        if (is_blank_line(&line))
+        {
+            line.pos = line.end + 1;
+            continue;
+        }
+
+        if (code_memory_size == capacity)
+        {
+            grown = realloc(code_memory,
+                            2 * capacity * sizeof(APEX_Instruction));
+            if (!grown)
+            {
+                free(code_memory);
+                munmap((void *)file, st.st_size);
+                return NULL;
+            }
+            code_memory = grown;
+            memset(&code_memory[capacity], 0,
+                   capacity * sizeof(APEX_Instruction));
+            capacity *= 2;
+        }
+
+        if (create_APEX_instruction(&code_memory[code_memory_size], &line))
+        {
+            free(code_memory);
+            munmap((void *)file, st.st_size);
+            return NULL;
+        }
+        code_memory_size++;
+
+        line.pos = line.end + 1;
+    }
+
+    munmap((void *)file, st.st_size);
+    if (!code_memory_size)
+    {
+        free(code_memory);
+        return NULL;
+    }
+    *size = code_memory_size;
+    return code_memory;
+}
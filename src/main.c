@@ -0,0 +1,167 @@
+/*
+ * main.c
+ *
+ * Author:
+ * Copyright (c) 2020, Gaurav Kothari (gkothar1@binghamton.edu)
+ * State University of New York at Binghamton
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "apex_cpu.h"
+#include "apex_macros.h"
+
+int
+main(int argc, char const *argv[])
+{
+    APEX_CPU *cpu;
+
+    fprintf(stderr, "APEX CPU Pipeline Simulator v%0.1lf\n", VERSION);
+
+    if ((argc == 4 || argc == 5) && strcmp(argv[2], "assemble") == 0)
+    {
+        /* Pass input file, optional data memory file, output image file */
+        if (APEX_image_assemble(argv[1], argc == 5 ? argv[4] : NULL, argv[3]))
+        {
+            exit(1);
+        }
+        return 0;
+    }
+
+    if ((argc == 4 || argc == 5) && strcmp(argv[2], "batch") == 0)
+    {
+        /* Pass manifest file, number of threads, optional results file */
+        if (APEX_batch_run(argv[1], atoi(argv[3]), argc == 5 ? argv[4] : NULL))
+        {
+            exit(1);
+        }
+        return 0;
+    }
+
+    if ((argc == 3 || argc == 4) && strcmp(argv[2], "render") == 0)
+    {
+        /* Pass binary trace file, optional output file */
+        if (APEX_trace_render(argv[1], argc == 4 ? argv[3] : NULL))
+        {
+            exit(1);
+        }
+        return 0;
+    }
+
+    /* Trace mode takes the trace file as an extra argument */
+    int base = argc >= 3 && strcmp(argv[2], "trace") == 0 ? 5 : 4;
+    APEX_Options options;
+    APEX_Checkpoint *checkpoint;
+    int i, valid = argc >= base;
+
+    /* Optional forwarding policy, data memory size, checkpoint file, unit
+     * timing, branch predictor, width, back end, caches and system */
+    APEX_options_init(&options);
+    for (i = base; i < argc && valid; ++i)
+    {
+        valid = APEX_parse_option(argv[i], &options) == 0;
+    }
+
+    if (!valid)
+    {
+        fprintf(stderr, "APEX_Help: Usage %s <input_file> <simulate/display/single_step/functional> <no of cycles> [<options>]\n", argv[0]);
+        fprintf(stderr, "           or %s <input_file> sample <no of instructions> [<options>]\n", argv[0]);
+        fprintf(stderr, "           or %s <input_file> trace <no of cycles> <trace_file> [<options>]\n", argv[0]);
+        fprintf(stderr, "           or %s <trace_file> render [<output_file>]\n", argv[0]);
+        fprintf(stderr, "           or %s <input_file> assemble <image_file> [<data_file>]\n", argv[0]);
+        fprintf(stderr, "           or %s <manifest_file> batch <no of threads> [<results_file>]\n", argv[0]);
+        fprintf(stderr, "           or %s <system_file> system <no of cycles> [<options>]\n", argv[0]);
+        fprintf(stderr, "           options: none/ex/full mem=<words> checkpoint=<checkpoint_file>\n");
+        fprintf(stderr, "                    state=<state_file>\n");
+        fprintf(stderr, "                    period=<n> warmup=<n> window=<n> (sample)\n");
+        fprintf(stderr, "                    alu=/mul=/div=/agu=<latency>[p] (p: pipelined)\n");
+        fprintf(stderr, "                    bp=none/static/bimodal/gshare bht=<counters> btb=<entries>\n");
+        fprintf(stderr, "                    width=<instructions per cycle>\n");
+        fprintf(stderr, "                    core=inorder/ooo rob=/iq=/lsq=<entries> prf=<registers>\n");
+        fprintf(stderr, "                    l1i=/l1d=/l2=<bytes>:<ways>:<line>[:lru/fifo/random] l2lat=/dram=<cycles>\n");
+        fprintf(stderr, "                    fetchblock=<bytes> iprefetch=none/nextline\n");
+        fprintf(stderr, "                    dprefetch=none/nextline/stride/stream pfentries=<entries> pfdegree=<lines>\n");
+        fprintf(stderr, "                    sb=<entries>/none sbdrain=<cycles>\n");
+        fprintf(stderr, "                    coherence=msi/mesi c2c=<cycles> quantum=<cycles> threads=<n> (system)\n");
+        exit(1);
+    }
+
+    /* Runs of billions of cycles or instructions take a 64-bit count */
+    char *end;
+    errno = 0;
+    long long n = strtoll(argv[3], &end, 10);
+    if (end == argv[3] || *end || errno == ERANGE)
+    {
+        fprintf(stderr, "APEX_Error: Invalid count %s\n", argv[3]);
+        exit(1);
+    }
+    if (strcmp(argv[2], "system") == 0)
+    {
+        /* Pass system file, number of cycles, options of every core */
+        if (APEX_system_run(argv[1], n, &options))
+        {
+            exit(1);
+        }
+        return 0;
+    }
+
+    cpu = APEX_cpu_init(argv[1],argv[2],n,options.data_memory_size);/* Pass input file or checkpoint, simulate/display/single_step/functional, number of cycles, data memory words*/
+    if (!cpu)
+    {
+        fprintf(stderr, "APEX_Error: Unable to initialize CPU\n");
+        exit(1);
+    }
+    if (APEX_cpu_set_options(cpu, &options))
+    {
+        exit(1);
+    }
+
+    if (base == 5)
+    {
+        cpu->trace = APEX_trace_open(argv[4], APEX_TRACE_BINARY, cpu->width,
+                                     cpu->code_memory, cpu->code_memory_size);
+        if (!cpu->trace)
+        {
+            exit(1);
+        }
+    }
+
+    if (cpu->functional)
+    {
+        APEX_functional_run(cpu);
+    }
+    else if (cpu->sampled)
+    {
+        if (APEX_sample_run(cpu, options.sample_period, options.sample_warmup,
+                            options.sample_window))
+        {
+            exit(1);
+        }
+    }
+    else
+    {
+        APEX_cpu_run(cpu);
+    }
+
+    /* Save where the run stopped, to be resumed by passing the checkpoint file
+     * as input file */
+    if (options.checkpoint)
+    {
+        checkpoint = APEX_checkpoint_take(cpu);
+        if (!checkpoint || APEX_checkpoint_save(checkpoint, options.checkpoint))
+        {
+            exit(1);
+        }
+        APEX_checkpoint_free(checkpoint);
+    }
+
+    /* Save the final registers, flags and data memory, to compare runs */
+    if (options.state && APEX_cpu_save_state(cpu, options.state))
+    {
+        exit(1);
+    }
+    APEX_cpu_stop(cpu);
+    return 0;
+}
\ No newline at end of file